@@ -0,0 +1,194 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// CPU cost of the coroutine API with hundreds of fetches in flight, one async controller per loopback bus and
+// several peripherals on each. The buses are instant, so what is left is the loop's own overhead:
+//   burst   - every fetch queued at once, to peripherals that answer
+//   pending - every fetch queued at once, to addresses nobody answers, so all of them wait until they time out
+//   paced   - one fetch per bus every 10 ms
+//   idle    - no fetches; the controllers only PING
+// Usage: bench_async [buses] [peripherals per bus] [fetches]
+
+#include "aus1_async.h"
+#include "arduino/aus1_peripheral.h"
+#include "i2c_loopback.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace superi2c;
+
+#define PAYLOAD_SIZE     64
+#define FIRST_ADDRESS    0x20
+#define ABSENT_ADDRESS   0x70
+#define PENDING_TIMEOUT  1000
+#define PACED_PERIOD_MS  10
+#define PHASE_MS         2000
+
+static buf provide() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = (uint8_t) i;
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+static double cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+struct counters {
+    unsigned long ok = 0;
+    unsigned long failed = 0;
+};
+
+static aus1_task fetch_once(aus1_async_controller *controller, uint8_t address, std::chrono::milliseconds timeout,
+                            counters *out) {
+    aus1_fetch_result result = co_await controller->fetch(address, timeout);
+    if (result.status == aus1_fetch_status::OK) {
+        out->ok++;
+    } else {
+        out->failed++;
+    }
+}
+
+// A loopback bus with its controller and peripherals
+struct bench_bus {
+    i2c_loopback_bus bus;
+    TwoWire controller_wire;
+    std::vector<std::unique_ptr<TwoWire>> wires;
+    std::vector<std::unique_ptr<aus1_peripheral>> peripherals;
+    aus1_async_controller controller;
+
+    bench_bus(aus1_event_loop *loop, int peripheral_count)
+        : controller_wire(&bus),
+          controller(loop, &controller_wire) {
+        controller_wire.begin(AUS1_I2C_ADDRESS);
+        for (int i = 0; i < peripheral_count; i++) {
+            wires.emplace_back(new TwoWire(&bus));
+            peripherals.emplace_back(new aus1_peripheral(wires.back().get(), 1, 1, &provide));
+            wires.back()->begin(FIRST_ADDRESS + i);
+        }
+        controller.controller().set_peripheral_address(FIRST_ADDRESS);
+    }
+};
+
+struct phase_result {
+    double wall_s;
+    double cpu_s;
+    unsigned long wakeups;
+};
+
+/**
+ * @brief Runs the loop until `done` holds or `budget_ms` has passed, measuring what it cost
+ */
+template <typename condition>
+static phase_result run_phase(aus1_event_loop &loop, unsigned long budget_ms, condition done) {
+    double cpu_start = cpu_seconds();
+    unsigned long start = millis(), wakeups = 0;
+    while (!done() && millis() - start < budget_ms) {
+        loop.run_once(100);
+        wakeups++;
+    }
+    return { (millis() - start) / 1000.0, cpu_seconds() - cpu_start, wakeups };
+}
+
+static void report(const char *name, const phase_result &result, const counters &fetches) {
+    printf("%-8s  %8.2f  %8lu  %8lu  %10.1f  %12.4f  %10.0f\n", name, result.wall_s, fetches.ok, fetches.failed,
+           result.wall_s > 0 ? fetches.ok / result.wall_s : 0.0,
+           result.wall_s > 0 ? result.cpu_s / result.wall_s : 0.0,
+           result.wall_s > 0 ? result.wakeups / result.wall_s : 0.0);
+}
+
+int main(int argc, char **argv) {
+    int bus_count = argc > 1 ? atoi(argv[1]) : 4;
+    int peripheral_count = argc > 2 ? atoi(argv[2]) : 8;
+    int fetch_count = argc > 3 ? atoi(argv[3]) : 256;
+
+    aus1_event_loop loop;
+    if (!loop.valid()) {
+        fprintf(stderr, "could not create the event loop\n");
+        return 1;
+    }
+    std::vector<std::unique_ptr<bench_bus>> buses;
+    for (int b = 0; b < bus_count; b++) buses.emplace_back(new bench_bus(&loop, peripheral_count));
+    run_phase(loop, 1000, [&] {
+        for (const std::unique_ptr<bench_bus> &bus : buses) {
+            if (!bus->controller.controller().connected()) return false;
+        }
+        return true;
+    });
+
+    printf("%d buses x %d peripherals, %d fetches of %d bytes, instant loopback\n",
+           bus_count, peripheral_count, fetch_count, PAYLOAD_SIZE);
+    printf("%-8s  %8s  %8s  %8s  %10s  %12s  %10s\n", "phase", "wall s", "ok", "failed", "fetches/s", "CPU s per s", "wakeups/s");
+
+    // Fetches spread over every peripheral, so consecutive ones on a bus switch address
+    {
+        counters fetches;
+        for (int i = 0; i < fetch_count; i++) {
+            bench_bus *bus = buses[i % bus_count].get();
+            fetch_once(&bus->controller, FIRST_ADDRESS + (i / bus_count) % peripheral_count,
+                       std::chrono::milliseconds(30000), &fetches);
+        }
+        phase_result result = run_phase(loop, 60000, [&] { return fetches.ok + fetches.failed == (unsigned long) fetch_count; });
+        report("burst", result, fetches);
+    }
+
+    {
+        counters fetches;
+        for (int i = 0; i < fetch_count; i++) {
+            fetch_once(&buses[i % bus_count]->controller, ABSENT_ADDRESS, std::chrono::milliseconds(PENDING_TIMEOUT), &fetches);
+        }
+        phase_result result = run_phase(loop, PENDING_TIMEOUT * 2, [&] { return fetches.ok + fetches.failed == (unsigned long) fetch_count; });
+        report("pending", result, fetches);
+    }
+
+    {
+        counters fetches;
+        double cpu_start = cpu_seconds();
+        unsigned long start = millis(), last = start, wakeups = 0, issued = 0;
+        while (millis() - start < PHASE_MS) {
+            if (millis() - last >= PACED_PERIOD_MS) {
+                last += PACED_PERIOD_MS;
+                for (int b = 0; b < bus_count; b++) {
+                    fetch_once(&buses[b]->controller, FIRST_ADDRESS + issued % peripheral_count,
+                               std::chrono::milliseconds(1000), &fetches);
+                }
+                issued++;
+            }
+            unsigned long since = millis() - last;
+            loop.run_once(since >= PACED_PERIOD_MS ? 0 : (int) (PACED_PERIOD_MS - since));
+            wakeups++;
+        }
+        run_phase(loop, 1000, [&] { return fetches.ok + fetches.failed == issued * bus_count; });
+        report("paced", { PHASE_MS / 1000.0, cpu_seconds() - cpu_start, wakeups }, fetches);
+    }
+
+    {
+        counters fetches;
+        phase_result result = run_phase(loop, PHASE_MS, [] { return false; });
+        report("idle", result, fetches);
+    }
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Duty cycle of an idle, connected link, from the meters of a build with AUS1_MEASURE_DUTY_CYCLE, at several PING
+// intervals. "tickless" sleeps until the deadline update() returns; "polling" calls update() in a tight loop, as a
+// sketch calling it from loop() would. The bus takes real time per transfer at 100 kHz, and Wire reads block, so
+// the controller's share includes waiting on the bus, as it would on a board. The peripheral's share is its Wire
+// callbacks, and update() where the application calls it.
+// Usage: bench_duty_cycle [seconds per point]
+
+#include "link.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace superi2c;
+
+#define CLOCK_RATE 100000
+
+static const unsigned long ping_intervals[] = { 5, 20, 100, 500 };
+
+static buf provide() {
+    uint8_t *data = new uint8_t[16];
+    for (size_t i = 0; i < 16; i++) data[i] = (uint8_t) i;
+    return buf{ data, 16 };
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2;
+
+    printf("idle link at %u Hz, %.1f s per point; duty cycle in permille, calls per second\n", CLOCK_RATE, seconds);
+    printf("%-9s  %-8s  %16s  %16s  %16s  %16s\n",
+           "ping ms", "mode", "controller duty", "controller calls", "peripheral duty", "peripheral calls");
+
+    for (unsigned long interval : ping_intervals) {
+        for (int tickless = 1; tickless >= 0; tickless--) {
+            aus1_link link(&provide);
+            host_clock_set_manual(false);
+            link.bus.set_timing(i2c_loopback_timing::REAL_TIME);
+            link.bus.set_clock(CLOCK_RATE);
+            link.controller.set_ping_interval(interval);
+            link.connect(1000);
+
+            link.controller.reset_duty_cycle();
+            link.peripheral.reset_duty_cycle();
+            unsigned long start = micros();
+            while (micros() - start < seconds * 1000000) {
+                unsigned long delay = link.controller.update();
+                link.peripheral.update();
+                if (tickless && delay != 0) std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            }
+
+            unsigned long now = micros();
+            const duty_cycle_meter &controller = link.controller.get_duty_cycle();
+            const duty_cycle_meter &peripheral = link.peripheral.get_duty_cycle();
+            double elapsed = (now - start) / 1000000.0;
+            printf("%-9lu  %-8s  %16u  %16.0f  %16u  %16.0f\n", interval, tickless ? "tickless" : "polling",
+                   duty_cycle_permille(&controller, now), controller.calls / elapsed,
+                   duty_cycle_permille(&peripheral, now), peripheral.calls / elapsed);
+        }
+    }
+
+    return 0;
+}
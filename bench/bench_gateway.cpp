@@ -0,0 +1,148 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Gateway reader throughput and publish latency, over a loopback bus clocked in real time.
+// Usage: bench_gateway [readers] [seconds]
+
+#include "aus1_gateway.h"
+#include "arduino/aus1_peripheral.h"
+#include "i2c_loopback.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+#include <unistd.h>
+
+using namespace superi2c;
+
+#define CLOCK_RATE   400000
+#define PAYLOAD_SIZE 64
+
+static uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+// The payload carries the time the peripheral produced it, so readers can tell how stale it is when they see it
+static buf provide() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE]();
+    uint64_t now = monotonic_ns();
+    memcpy(data, &now, sizeof(now));
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+static uint64_t percentile(std::vector<uint64_t> &values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t) (p * (values.size() - 1))];
+}
+
+int main(int argc, char **argv) {
+    int reader_count = argc > 1 ? atoi(argv[1]) : 4;
+    int seconds = argc > 2 ? atoi(argv[2]) : 2;
+    std::string name = "/aus1-gateway-bench-" + std::to_string(getpid());
+
+    i2c_loopback_bus bus;
+    bus.set_timing(i2c_loopback_timing::REAL_TIME);
+    bus.set_clock(CLOCK_RATE);
+    TwoWire controller_wire(&bus);
+    TwoWire peripheral_wire(&bus);
+    controller_wire.begin();
+    peripheral_wire.begin(AUS1_I2C_ADDRESS);
+    aus1_peripheral peripheral(&peripheral_wire, 1, 1, &provide);
+
+    aus1_gateway_region region;
+    if (!region.create(name.c_str(), 1)) {
+        fprintf(stderr, "could not create %s\n", name.c_str());
+        return 1;
+    }
+    aus1_gateway gateway(&region);
+    gateway.add_bus(&controller_wire);
+    gateway.start();
+
+    std::atomic<bool> running(true);
+    std::vector<uint64_t> reads(reader_count, 0);
+    std::vector<std::vector<uint64_t>> fetch_latencies(reader_count);
+    std::vector<std::vector<uint64_t>> visible_latencies(reader_count);
+    std::vector<std::thread> readers;
+
+    for (int r = 0; r < reader_count; r++) {
+        readers.emplace_back([&, r]() {
+            aus1_gateway_region reader;
+            if (!reader.open(name.c_str())) return;
+
+            const aus1_gateway_slot *slot = reader.slot(0);
+            uint64_t last_count = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                uint64_t count = 0, produced_ns = 0, published_ns = 0;
+                size_t size = 0;
+                reader.view(0, [&](const uint8_t *data, size_t data_size) {
+                    size = data_size;
+                    count = slot->publish_count;
+                    published_ns = slot->published_ns;
+                    if (data_size >= sizeof(produced_ns)) memcpy(&produced_ns, data, sizeof(produced_ns));
+                });
+                reads[r]++;
+
+                // Split into the fetch over the bus and the time until this reader first sees the publish
+                if (size == PAYLOAD_SIZE && count != last_count) {
+                    fetch_latencies[r].push_back(published_ns - produced_ns);
+                    visible_latencies[r].push_back(monotonic_ns() - published_ns);
+                    last_count = count;
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running.store(false);
+    for (std::thread &t : readers) t.join();
+    gateway.stop();
+
+    uint64_t total_reads = 0;
+    std::vector<uint64_t> fetch, visible;
+    for (int r = 0; r < reader_count; r++) {
+        total_reads += reads[r];
+        fetch.insert(fetch.end(), fetch_latencies[r].begin(), fetch_latencies[r].end());
+        visible.insert(visible.end(), visible_latencies[r].begin(), visible_latencies[r].end());
+    }
+
+    uint64_t publishes = region.slot(0)->publish_count;
+    double transfer_us = (double) bus.transfer_ns(AUS1_DATA_PACKET_SIZE) / 1000;
+    printf("readers: %d, %d s, %u Hz bus, %d-byte payload, %u CPUs\n",
+           reader_count, seconds, CLOCK_RATE, PAYLOAD_SIZE, std::thread::hardware_concurrency());
+    printf("publishes: %llu (%.1f/s)\n", (unsigned long long) publishes, (double) publishes / seconds);
+    printf("reader throughput: %.2f M reads/s total, %.2f M reads/s per reader\n",
+           total_reads / 1e6 / seconds, total_reads / 1e6 / seconds / (reader_count ? reader_count : 1));
+    printf("fetch latency (produced -> published): p50 %.1f us, p99 %.1f us, max %.1f us (%zu samples)\n",
+           percentile(fetch, 0.5) / 1000.0, percentile(fetch, 0.99) / 1000.0, percentile(fetch, 1.0) / 1000.0, fetch.size());
+    printf("publish latency (published -> seen by reader): p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           percentile(visible, 0.5) / 1000.0, percentile(visible, 0.99) / 1000.0, percentile(visible, 1.0) / 1000.0);
+    printf("for scale, one %d-byte chunk takes %.1f us on the bus\n", AUS1_DATA_PACKET_SIZE, transfer_us);
+
+    return 0;
+}
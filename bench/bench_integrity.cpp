@@ -0,0 +1,107 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Cost of each integrity check: host CPU time per byte, and fetch latency on a simulated 400 kHz bus.
+// Host CPU time only ranks the checks; 8-bit parts are far slower, and favour Fletcher-16 more.
+
+#include "link.h"
+
+extern "C" {
+    #include "aus1.h"
+}
+
+#include <chrono>
+#include <cstdio>
+
+using namespace superi2c;
+
+#define CLOCK_RATE 400000
+#define FETCHES    200
+
+static const uint8_t integrities[] = {
+    AUS1_INTEGRITY_CRC32, AUS1_INTEGRITY_CRC16_CCITT, AUS1_INTEGRITY_CRC8, AUS1_INTEGRITY_FLETCHER16
+};
+static const char *names[] = { "CRC32", "CRC16-CCITT", "CRC8", "Fletcher16" };
+static const size_t payload_sizes[] = { 16, 256, 4096 };
+
+static size_t payload_size;
+
+static buf provide() {
+    uint8_t *data = new uint8_t[payload_size];
+    for (size_t i = 0; i < payload_size; i++) data[i] = (uint8_t) i;
+    return buf{ data, payload_size };
+}
+
+/**
+ * @brief Times computing a check over a buffer, repeated until enough time has passed to be measurable
+ *
+ * @return The time per byte in nanoseconds
+ */
+static double ns_per_byte(uint8_t integrity, const uint8_t *buf, size_t len) {
+    volatile uint32_t sink = 0;
+    size_t rounds = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds elapsed(0);
+    while (elapsed < std::chrono::milliseconds(50)) {
+        for (int i = 0; i < 64; i++) sink = sink + aus1_integrity_compute(integrity, buf, len);
+        rounds += 64;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    return (double) elapsed.count() / ((double) rounds * len);
+}
+
+int main() {
+    static uint8_t buf[4096];
+    for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (uint8_t) (i * 37);
+
+    printf("host CPU time, ns per byte\n");
+    printf("%-12s", "check");
+    for (size_t size : payload_sizes) printf("  %9zu B", size);
+    printf("\n");
+    for (size_t c = 0; c < sizeof(integrities); c++) {
+        printf("%-12s", names[c]);
+        for (size_t size : payload_sizes) printf("  %11.2f", ns_per_byte(integrities[c], buf, size));
+        printf("\n");
+    }
+
+    printf("\nfetch latency on a simulated %u Hz bus, us (START-OF-STREAM bytes in brackets)\n", CLOCK_RATE);
+    printf("%-12s", "check");
+    for (size_t size : payload_sizes) printf("  %9zu B", size);
+    printf("\n");
+    for (size_t c = 0; c < sizeof(integrities); c++) {
+        printf("%-12s", names[c]);
+        for (size_t size : payload_sizes) {
+            payload_size = size;
+
+            aus1_link link(&provide);
+            link.bus.set_clock(CLOCK_RATE);
+            link.controller.set_integrity(integrities[c]);
+            link.connect(1000);
+
+            std::vector<uint8_t> data;
+            unsigned long start = micros();
+            for (int i = 0; i < FETCHES; i++) link.fetch(data, 1000);
+            printf("  %7.1f (%d)", (double) (micros() - start) / FETCHES, aus1_start_of_stream_size(integrities[c]));
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Bus idle time between the chunks of a stream, on a loopback bus that takes real time per transfer.
+// The controller is updated in a tight loop. Wire reads block, so the idle time is what draining, decoding and
+// checking one chunk costs on the host; the decode column times that last part on its own for comparison.
+// Usage: bench_transfer [fetches per point]
+
+#include "link.h"
+
+extern "C" {
+    #include "aus1.h"
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace superi2c;
+
+#define PAYLOAD_SIZE 1024
+
+static const uint32_t clock_rates[] = { 100000, 400000, 1000000 };
+
+static buf provide() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = (uint8_t) i;
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+static double percentile(std::vector<uint64_t> &values, double p) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[(size_t) (p * (values.size() - 1))] / 1000.0;
+}
+
+/**
+ * @brief Times decoding one chunk and folding it into the CRC32 check, as the controller does for each chunk
+ *
+ * @return The time per chunk in microseconds
+ */
+static double decode_us(bool fec) {
+    uint8_t payload[AUS1_FEC_CHUNK_DATA_SIZE];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t) (i * 13);
+    uint8_t chunk[AUS1_DATA_PACKET_SIZE];
+    aus1_fec_encode_chunk(chunk, payload);
+
+    const int rounds = 100000;
+    volatile uint32_t sink = 0;
+    uint8_t out[AUS1_DATA_PACKET_SIZE];
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+        uint32_t state = aus1_integrity_init(AUS1_INTEGRITY_CRC32);
+        if (fec) {
+            aus1_fec_decode_chunk(out, chunk);
+            state = aus1_integrity_update(AUS1_INTEGRITY_CRC32, state, out, AUS1_FEC_CHUNK_DATA_SIZE);
+        } else {
+            state = aus1_integrity_update(AUS1_INTEGRITY_CRC32, state, chunk, AUS1_DATA_PACKET_SIZE);
+        }
+        sink = sink + state;
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+int main(int argc, char **argv) {
+    int fetches = argc > 1 ? atoi(argv[1]) : 20;
+
+    printf("%d-byte payload, %d fetches per point; idle is from the end of one chunk read to the start of the next\n",
+           PAYLOAD_SIZE, fetches);
+    printf("%-8s  %-4s  %10s  %10s  %10s  %10s  %10s  %12s\n",
+           "rate", "FEC", "chunk us", "decode us", "idle p50", "idle p99", "idle max", "utilization");
+
+    for (uint32_t rate : clock_rates) {
+        for (int fec = 0; fec < 2; fec++) {
+            aus1_link link(&provide);
+            host_clock_set_manual(false);
+            link.bus.set_timing(i2c_loopback_timing::REAL_TIME);
+            link.bus.set_clock(rate);
+            link.peripheral.set_capabilities(AUS1_CAPABILITY_FEC);
+            link.controller.set_fec_enabled(fec);
+            link.connect(1000);
+
+            std::vector<uint64_t> idle;
+            uint64_t busy_ns = 0, stream_ns = 0;
+            std::vector<uint8_t> data;
+            for (int i = 0; i < fetches; i++) {
+                link.bus.clear_trace();
+                link.bus.set_trace(true);
+                link.fetch(data, 5000);
+                link.bus.set_trace(false);
+
+                // Only the gaps between chunk reads; the gap before the first depends on START-OF-STREAM handling
+                std::vector<i2c_loopback_transfer> trace = link.bus.get_trace();
+                size_t first = 0;
+                while (first < trace.size() && trace[first].length != AUS1_DATA_PACKET_SIZE) first++;
+                if (first == trace.size()) continue;
+
+                for (size_t j = first + 1; j < trace.size(); j++) idle.push_back(trace[j].start_ns - trace[j - 1].end_ns);
+                for (size_t j = first; j < trace.size(); j++) busy_ns += trace[j].end_ns - trace[j].start_ns;
+                stream_ns += trace.back().end_ns - trace[first].start_ns;
+            }
+
+            printf("%-8u  %-4s  %10.1f  %10.2f  %10.1f  %10.1f  %10.1f  %11.2f%%\n", rate, fec ? "on" : "off",
+                   link.bus.transfer_ns(AUS1_DATA_PACKET_SIZE) / 1000.0, decode_us(fec),
+                   percentile(idle, 0.5), percentile(idle, 0.99), percentile(idle, 1.0),
+                   stream_ns ? 100.0 * busy_ns / stream_ns : 0.0);
+        }
+    }
+
+    return 0;
+}
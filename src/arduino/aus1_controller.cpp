@@ -19,52 +19,228 @@
 #include "aus1_controller.h"
 
 #include "../aus1.h"
-#include "../util/crc32.h"
 
 #include <cstdint>
+#include <cstring>
 
 #define WIRE_TIMEOUT_ERR_CODE 5
 
+// Time to let bytes nobody asked for drain while idle
+#define DRAIN_WINDOW_MS 10
+
 namespace superi2c {
     aus1_controller::aus1_controller(TwoWire *wire)
         : wire(wire),
           state(aus1_controller_state::IDLE),
           is_connected(false),
+          peripheral_address(AUS1_I2C_ADDRESS),
           device_type(0),
           device_version(0),
+          requested_capabilities(0),
+          capabilities(0),
+          requested_integrity(AUS1_INTEGRITY_CRC32),
+          integrity(AUS1_INTEGRITY_CRC32),
           receiver(nullptr),
+          context_receiver(nullptr),
+          receiver_context(nullptr),
           data(nullptr),
+          data_buffer_size(0),
           data_loc(0),
+          chunk_count(0),
+          chunks_requested(0),
+          chunks_processed(0),
+          integrity_state(0),
+          chunk_uncorrectable(false),
+          corrected_bits(0),
+          timeout_period(500),
+          ping_interval(AUS1_DEFAULT_PING_INTERVAL_MS),
           last_ping_ms(0),
-          last_bytes_received_ms(0) {}
+          last_bytes_received_ms(0),
+          last_stray_bytes_ms(0),
+          clock_rate_count(0),
+          clock_index(0),
+          clock_error_budget(0),
+          clock_window(0),
+          peripheral_count(0),
+          discovery_requested(false),
+          discovery_mode(AUS1_DISCOVER_MODE_ANNOUNCE),
+          discovery_window_ms(AUS1_DEFAULT_DISCOVERY_WINDOW_MS),
+          discovery_started_ms(0),
+          replies_size(0),
+          instance_slot(instances::claim(this)),
+          liveness_interval(0),
+          last_liveness_ms(0) {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_reset(&duty_cycle, micros());
+#endif
+
+        // Discovery replies are written to the controller, so they arrive through the receive callback
+        wire->onReceive(instances::int_trampoline<&aus1_controller::receive_reply>(instance_slot));
+    }
+
+    aus1_controller::~aus1_controller() {
+        if (instance_slot != AUS1_MAX_CONTROLLER_INSTANCES) wire->onReceive(nullptr);
+        instances::release(instance_slot);
+        delete[] data;
+    }
 
     bool aus1_controller::connected() const { return is_connected; }
 
     void aus1_controller::set_timeout_period(unsigned long period) { this->timeout_period = period; }
 
+    void aus1_controller::set_ping_interval(unsigned long interval) { this->ping_interval = interval; }
+
+    void aus1_controller::set_peripheral_address(uint8_t address) {
+        if (address == peripheral_address) return;
+        peripheral_address = address;
+
+        // What the last PING negotiated was with another peripheral, so PING the new one before requesting from it
+        is_connected = false;
+        last_ping_ms = millis() - ping_interval - 1;
+    }
+
+    void aus1_controller::discover(uint8_t window_ms) {
+        discovery_window_ms = window_ms;
+        discovery_requested = true;
+    }
+
+    void aus1_controller::set_liveness_interval(unsigned long interval) { this->liveness_interval = interval; }
+
+    size_t aus1_controller::get_peripheral_count() const { return peripheral_count; }
+
+    const aus1_peripheral_entry *aus1_controller::get_peripheral(size_t index) const {
+        if (index >= peripheral_count) return nullptr;
+        return &peripherals[index];
+    }
+
+    bool aus1_controller::peripheral_alive(size_t index) const {
+        if (index >= peripheral_count) return false;
+        return millis() - peripherals[index].last_seen_ms <= liveness_interval + discovery_period() + timeout_period;
+    }
+
     void aus1_controller::request_data(receiver_function receiver) { this->receiver = receiver; }
 
+    void aus1_controller::request_data(context_receiver_function receiver, void *context) {
+        this->context_receiver = receiver;
+        this->receiver_context = context;
+    }
+
+    void aus1_controller::cancel_request() {
+        clear_receiver();
+
+        if (state == aus1_controller_state::AWAITING_START_OF_STREAM || state == aus1_controller_state::RECEIVING_DATA) {
+            // A chunk still waiting in the wire is drained while idle; the next STREAM-REQUEST drops the rest of the stream
+            state = aus1_controller_state::IDLE;
+            reset(0);
+        }
+    }
+
+    bool aus1_controller::enable_clock_tuning(const uint32_t *rates, size_t count, uint16_t error_budget, uint16_t window) {
+        if (count == 0 || count > AUS1_MAX_CLOCK_RATES || window == 0) return false;
+
+        for (size_t i = 0; i < count; i++) {
+            clock_rates[i].rate = rates[i];
+            clock_rates[i].transactions = 0;
+            clock_rates[i].errors = 0;
+            clock_rates[i].holdoff = 0;
+            clock_rates[i].backoff = 1;
+        }
+        clock_rate_count = count;
+        clock_error_budget = error_budget;
+        clock_window = window;
+
+        set_clock_index(0); // start conservative and work upwards
+        return true;
+    }
+
+    void aus1_controller::disable_clock_tuning() { clock_rate_count = 0; }
+
+    uint32_t aus1_controller::get_clock_rate() const {
+        if (clock_rate_count == 0) return 0;
+        return clock_rates[clock_index].rate;
+    }
+
+    void aus1_controller::set_fec_enabled(bool enabled) {
+        if (enabled) {
+            requested_capabilities |= AUS1_CAPABILITY_FEC;
+        } else {
+            requested_capabilities &= ~AUS1_CAPABILITY_FEC;
+        }
+    }
+
+    void aus1_controller::set_integrity(uint8_t integrity) { this->requested_integrity = integrity; }
+
+    uint8_t aus1_controller::get_integrity() const { return integrity; }
+
+    uint8_t aus1_controller::get_capabilities() const { return capabilities; }
+
+    uint32_t aus1_controller::get_corrected_bit_count() const { return corrected_bits; }
+
+    uint32_t aus1_controller::get_device_type() const { return device_type; }
+
+    uint16_t aus1_controller::get_device_version() const { return device_version; }
+
     aus1_controller_state aus1_controller::get_state() const { return state; }
 
-    void aus1_controller::update() {
-        unsigned long current_time = millis();
+    unsigned long aus1_controller::update() {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_begin(&duty_cycle, micros());
+#endif
+
+        process(millis());
+        unsigned long next_update = time_until_next_update(millis());
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_end(&duty_cycle, micros());
+#endif
+        return next_update;
+    }
+
+    uint8_t aus1_controller::wake_events() const {
+        // While a reply is outstanding the peripheral can make progress before the deadline does
+        if (state == aus1_controller_state::AWAITING_PING_RESPONSE
+            || state == aus1_controller_state::AWAITING_START_OF_STREAM
+            || state == aus1_controller_state::RECEIVING_DATA
+            || state == aus1_controller_state::DISCOVERING) {
+            return AUS1_WAKE_DEADLINE | AUS1_WAKE_BUS;
+        }
+        return AUS1_WAKE_DEADLINE;
+    }
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+    const duty_cycle_meter &aus1_controller::get_duty_cycle() const { return duty_cycle; }
+
+    void aus1_controller::reset_duty_cycle() { duty_cycle_reset(&duty_cycle, micros()); }
+#endif
+
+    void aus1_controller::process(unsigned long current_time) {
 
         // Write wire data
         if (wire->available()) {
-            last_bytes_received_ms = millis();
+            // Not millis(): a later time than `current_time` would wrap the timeout check below and fail the transfer
+            last_bytes_received_ms = current_time;
+            // Replies are only ever read on purpose, so bytes showing up while idle are strays
+            if (state == aus1_controller_state::IDLE) last_stray_bytes_ms = last_bytes_received_ms;
         }
         while (wire->available()) {
-            if (data_loc == data_buffer_size) break; // Discard overflowing buffer data
-            data[data_loc++] = wire->read(); 
+            uint8_t byte = wire->read();
+            if (data_loc < data_buffer_size) data[data_loc++] = byte; // Discard overflowing buffer data
         }
 
+        // Replies can trail in after their round, and still count
+        collect_discovery_replies(current_time);
+
         // Failsafe: if state is IDLE and wire is receieving data, something has gone wrong.
         // Await for the stream of data to end (hopefully it does) by waiting 10ms
-        if (state == aus1_controller_state::IDLE && current_time - last_bytes_received_ms <= 10) return;
+        if (state == aus1_controller_state::IDLE && current_time - last_stray_bytes_ms <= DRAIN_WINDOW_MS) return;
 
         // If the controller is not IDLE, then it must be receiving data.
-        // Assume the module was disconnected if the time the last bytes were receieved exceeds the timeout
-        if (state != aus1_controller_state::IDLE && current_time - last_bytes_received_ms > timeout_period) {
+        // Assume the module was disconnected if the time the last bytes were receieved exceeds the timeout.
+        // Discovery may legitimately hear nothing, so it ends on its own schedule instead.
+        if (state != aus1_controller_state::IDLE
+            && state != aus1_controller_state::DISCOVERING
+            && current_time - last_bytes_received_ms > timeout_period) {
+            record_transaction(false);
             state = aus1_controller_state::IDLE;
             is_connected = false;
             reset(0);
@@ -77,14 +253,19 @@ namespace superi2c {
                     aus1_ping_response_packet packet = aus1_decode_ping_response(data);
 
                     if (packet.peripheral_type == 0) { // invalid packet
+                        record_transaction(false);
                         is_connected = false;
-                        receiver = nullptr;
+                        clear_receiver();
                         reset(0);
                     } else {
                         device_type = packet.peripheral_type;
                         device_version = packet.peripheral_version;
+                        capabilities = packet.capabilities & requested_capabilities; // never trust more than was asked for
+                        // Peripherals that do not know the requested check fall back to CRC32
+                        integrity = aus1_integrity_size(packet.integrity) ? packet.integrity : AUS1_INTEGRITY_CRC32;
                         is_connected = true;
                         last_ping_ms = current_time;
+                        record_transaction(true);
                     }
 
                     state = aus1_controller_state::IDLE;
@@ -93,33 +274,57 @@ namespace superi2c {
             break;
 
             case aus1_controller_state::AWAITING_START_OF_STREAM:
-                if (data_loc == AUS1_START_OF_STREAM_PACKET_SIZE) {
-                    aus1_start_of_stream_packet packet = aus1_decode_start_of_stream(data);
+                if (data_loc == aus1_start_of_stream_size(integrity)) {
+                    aus1_start_of_stream_packet packet = aus1_decode_start_of_stream(data, integrity);
                     
                     if (packet.data_size == 0) { // invalid packet
+                        record_transaction(false);
                         state = aus1_controller_state::IDLE;
                         is_connected = false;
-                        receiver = nullptr;
+                        clear_receiver();
                         reset(0);
                         break;
                     }
 
                     received_data_size = packet.data_size;
-                    data_crc_hash = packet.crc_hash;
+                    data_check_value = packet.check_value;
+
+                    // Every chunk is padded to full size, and carries less payload with FEC
+                    uint8_t chunk_data_size = aus1_chunk_data_size(capabilities);
+                    chunk_count = (packet.data_size + chunk_data_size - 1) / chunk_data_size;
+                    reset(chunk_count * AUS1_DATA_PACKET_SIZE); // set buffer to new size
+                    chunks_requested = 0;
+                    chunks_processed = 0;
+                    chunk_uncorrectable = false;
+                    integrity_state = aus1_integrity_init(integrity);
 
-                    reset(packet.data_size + (packet.data_size % AUS1_DATA_PACKET_SIZE)); // set buffer to new size
                     state = aus1_controller_state::RECEIVING_DATA;
+                    if (!request_next_chunk()) lose_peripheral(current_time); // read the first chunk straight away
                 }
 
             break;
             
             case aus1_controller_state::RECEIVING_DATA:
-                if (data_buffer_size == data_loc) {
-                    // Check CRC checksum
-                    if (crc32buf(data, data_buffer_size) == data_crc_hash) {
-                        receiver(data, received_data_size + (received_data_size % AUS1_DATA_PACKET_SIZE), data_buffer_size);
+                // Reads block until the chunk has arrived, so nothing can overlap them: the bus idles while a chunk
+                // is decoded and checked, whether the next read comes before or after. Decoding first means an
+                // uncorrectable chunk ends the stream without one more read.
+                while (chunks_processed < data_loc / AUS1_DATA_PACKET_SIZE) {
+                    process_chunk(chunks_processed++);
+                }
+
+                // An uncorrectable chunk fails the stream whatever follows, so stop reading it; a corrupted
+                // START-OF-STREAM could otherwise have the controller read out thousands of padding chunks.
+                // The next STREAM-REQUEST drops the rest.
+                if (chunk_uncorrectable) chunks_processed = chunk_count;
+
+                if (chunks_processed == chunk_count) {
+                    // Check the negotiated integrity check, accumulated chunk by chunk
+                    if (!chunk_uncorrectable && aus1_integrity_final(integrity, integrity_state) == data_check_value) {
+                        record_transaction(true);
+                        deliver(data, received_data_size, data_buffer_size);
                     } else {
-                        receiver(nullptr, 0, 0);
+                        record_transaction(false);
+                        deliver(nullptr, 0, 0);
                     }
 
                     // Remove data buffer
@@ -128,34 +333,65 @@ namespace superi2c {
                     data_loc = 0;
                     data_buffer_size = 0;
 
-                    receiver = nullptr;
-
                     state = aus1_controller_state::IDLE;
-
                     break;
                 }
 
-                if ((data_loc - 1) % AUS1_DATA_PACKET_SIZE == 0) {
-                    wire->requestFrom(AUS1_I2C_ADDRESS, AUS1_DATA_REQUEST_SIZE);
-                }
+                if (!request_next_chunk()) lose_peripheral(current_time);
                 
             break;
 
+            case aus1_controller_state::DISCOVERING:
+                // A heartbeat round is done once every known peripheral has answered; only stragglers wait it out
+                if (current_time - discovery_started_ms > discovery_period()
+                    || (discovery_mode == AUS1_DISCOVER_MODE_HEARTBEAT && all_peripherals_seen_since(discovery_started_ms, current_time))) {
+                    state = aus1_controller_state::IDLE;
+                    reset(0);
+                }
+
+            break;
+
             case aus1_controller_state::IDLE:
-                if (receiver != nullptr) { // a data retrieval is requested
-                    wire->requestFrom(AUS1_I2C_ADDRESS, AUS1_DATA_REQUEST_SIZE);
-                    reset(AUS1_START_OF_STREAM_PACKET_SIZE);
-                    state = aus1_controller_state::AWAITING_START_OF_STREAM;
-                } else if (current_time - last_ping_ms > 20) { // interval to ping is up
-                    uint8_t *packet = new uint8_t[AUS1_PING_PACKET_SIZE];
-                    aus1_encode_ping(packet);
+                tune_clock(); // only change rates between transactions
 
-                    if (send_transmission(packet, AUS1_PING_PACKET_SIZE) == WIRE_TIMEOUT_ERR_CODE) {
-                        is_connected = false;
+                if (has_receiver() && is_connected) { // a data retrieval is requested; otherwise it waits for a PING to connect
+                    uint8_t start_of_stream_size = aus1_start_of_stream_size(integrity); // shrinks with the integrity check
+
+                    // Mark the start of the stream, so a peripheral still holding an abandoned one starts afresh
+                    uint8_t packet[AUS1_STREAM_REQUEST_PACKET_SIZE];
+                    aus1_encode_stream_request(packet);
+
+                    if (send_transmission(peripheral_address, packet, AUS1_STREAM_REQUEST_PACKET_SIZE) != 0
+                        || wire->requestFrom(peripheral_address, start_of_stream_size) == 0) {
+                        // NACK or bus error: nothing is coming, so wait for the next PING to find the peripheral again
+                        lose_peripheral(current_time);
+                        break;
+                    }
+                    reset(start_of_stream_size);
+                    last_bytes_received_ms = current_time; // the timeout runs from the request, not the last reply
+                    state = aus1_controller_state::AWAITING_START_OF_STREAM;
+                } else if (discovery_requested) {
+                    discovery_requested = false;
+                    start_discovery(AUS1_DISCOVER_MODE_ANNOUNCE, current_time);
+                } else if (liveness_interval != 0 && peripheral_count != 0
+                           && current_time - last_liveness_ms > liveness_interval) {
+                    // One broadcast checks every discovered peripheral, instead of one PING each
+                    last_liveness_ms = current_time;
+                    start_discovery(AUS1_DISCOVER_MODE_HEARTBEAT, current_time);
+                } else if (current_time - last_ping_ms > ping_interval) { // interval to ping is up
+                    aus1_ping_packet ping = { requested_capabilities, requested_integrity };
+                    uint8_t packet[AUS1_PING_PACKET_SIZE];
+                    aus1_encode_ping(packet, &ping);
+
+                    // The peripheral prepares its PING-RESPONSE as the PING lands, ready for the read
+                    if (send_transmission(peripheral_address, packet, AUS1_PING_PACKET_SIZE) != 0
+                        || wire->requestFrom(peripheral_address, AUS1_PING_RESPONSE_PACKET_SIZE) == 0) {
+                        lose_peripheral(current_time); // NACK or bus error: nobody will answer
                         break;
                     }
 
                     reset(AUS1_PING_RESPONSE_PACKET_SIZE);
+                    last_bytes_received_ms = current_time; // the timeout runs from the request, not the last reply
                     state = aus1_controller_state::AWAITING_PING_RESPONSE;
                 }
 
@@ -164,15 +400,252 @@ namespace superi2c {
         }
     }
 
+    unsigned long aus1_controller::time_until_next_update(unsigned long current_time) const {
+        if (wire->available()) return 0; // a reply is already waiting to be drained
+
+        switch (state) {
+            case aus1_controller_state::RECEIVING_DATA:
+            case aus1_controller_state::AWAITING_PING_RESPONSE:
+            case aus1_controller_state::AWAITING_START_OF_STREAM:
+                // The reply wakes the application over the bus; otherwise give up once the timeout is up
+                return time_until(current_time, last_bytes_received_ms, timeout_period);
+
+            case aus1_controller_state::DISCOVERING:
+                return time_until(current_time, discovery_started_ms, discovery_period());
+
+            case aus1_controller_state::IDLE: {
+                if (current_time - last_stray_bytes_ms <= DRAIN_WINDOW_MS) {
+                    return time_until(current_time, last_stray_bytes_ms, DRAIN_WINDOW_MS);
+                }
+                if ((has_receiver() && is_connected) || discovery_requested) return 0;
+
+                unsigned long next_ping = time_until(current_time, last_ping_ms, ping_interval);
+                if (liveness_interval == 0 || peripheral_count == 0) return next_ping;
+
+                unsigned long next_liveness = time_until(current_time, last_liveness_ms, liveness_interval);
+                return next_liveness < next_ping ? next_liveness : next_ping;
+            }
+        }
+
+        return 0;
+    }
+
+    unsigned long aus1_controller::time_until(unsigned long current_time, unsigned long since, unsigned long period) {
+        unsigned long elapsed = current_time - since;
+        return elapsed > period ? 0 : period - elapsed + 1; // periods are checked with `>`, so expire one tick later
+    }
+
+    bool aus1_controller::request_next_chunk() {
+        // Requesting again before the previous chunk was drained would overwrite it in the wire's buffer
+        if (chunks_requested == chunk_count || chunks_requested != data_loc / AUS1_DATA_PACKET_SIZE) return true;
+
+        if (wire->requestFrom(peripheral_address, AUS1_DATA_PACKET_SIZE) == 0) return false; // NACK
+        chunks_requested++;
+        return true;
+    }
+
+    void aus1_controller::lose_peripheral(unsigned long current_time) {
+        record_transaction(false);
+        is_connected = false;
+        last_ping_ms = current_time; // look for it again at the next PING rather than every update
+        clear_receiver();
+        state = aus1_controller_state::IDLE;
+        reset(0);
+    }
+
+    void aus1_controller::process_chunk(size_t index) {
+        uint8_t chunk_data_size = aus1_chunk_data_size(capabilities);
+        uint8_t *payload = data + index * chunk_data_size;
+
+        // Correct the chunk, compacting the payload to the front of the buffer
+        if (capabilities & AUS1_CAPABILITY_FEC) {
+            int corrected = aus1_fec_decode_chunk(payload, data + index * AUS1_DATA_PACKET_SIZE);
+            if (corrected < 0) {
+                chunk_uncorrectable = true;
+            } else {
+                corrected_bits += corrected;
+            }
+        }
+
+        // The final chunk's padding is not covered by the check
+        size_t remaining = received_data_size - index * chunk_data_size;
+        size_t len = remaining < chunk_data_size ? remaining : chunk_data_size;
+        integrity_state = aus1_integrity_update(integrity, integrity_state, payload, len);
+    }
+
     void aus1_controller::reset(size_t new_buffer_size) {
         data_loc = 0;
-        if (!data) delete[] data;
+        delete[] data;
         data = new uint8_t[new_buffer_size];
         data_buffer_size = new_buffer_size;
     }
 
-    int aus1_controller::send_transmission(uint8_t *buf, size_t len) {
-        wire->beginTransmission(AUS1_I2C_ADDRESS);
+    void aus1_controller::record_transaction(bool ok) {
+        // Count failures even once the link is lost: a rate too fast to get any valid reply must still fall back
+        if (clock_rate_count == 0) return;
+
+        aus1_clock_rate_stats &current = clock_rates[clock_index];
+        current.transactions++;
+        if (!ok) current.errors++;
+    }
+
+    void aus1_controller::tune_clock() {
+        if (clock_rate_count == 0) return;
+
+        aus1_clock_rate_stats &current = clock_rates[clock_index];
+        if (current.transactions < clock_window) return;
+
+        bool over_budget = (uint32_t) current.errors * 1000 > (uint32_t) clock_error_budget * current.transactions;
+        current.transactions = 0;
+        current.errors = 0;
+
+        for (uint8_t i = 0; i < clock_rate_count; i++) {
+            if (clock_rates[i].holdoff > 0) clock_rates[i].holdoff--;
+        }
+
+        if (over_budget) {
+            if (clock_index == 0) return; // nothing slower to fall back to
+
+            // Wait before probing this rate again, twice as long as last time
+            current.holdoff = current.backoff;
+            if (current.backoff < AUS1_MAX_CLOCK_BACKOFF) current.backoff *= 2;
+
+            set_clock_index(clock_index - 1);
+            return;
+        }
+
+        current.backoff = 1;
+
+        // Within budget: probe the next faster rate unless it failed recently
+        if (clock_index + 1 < clock_rate_count && clock_rates[clock_index + 1].holdoff == 0) {
+            set_clock_index(clock_index + 1);
+        }
+    }
+
+    void aus1_controller::set_clock_index(uint8_t index) {
+        clock_index = index;
+        clock_rates[index].transactions = 0;
+        clock_rates[index].errors = 0;
+        wire->setClock(clock_rates[index].rate);
+    }
+
+    bool aus1_controller::has_receiver() const { return receiver != nullptr || context_receiver != nullptr; }
+
+    void aus1_controller::deliver(uint8_t *buf, size_t data_size, size_t buf_size) {
+        receiver_function plain = receiver;
+        context_receiver_function with_context = context_receiver;
+        void *context = receiver_context;
+
+        // Clear first so the receiver is free to issue the next request
+        clear_receiver();
+
+        if (plain) plain(buf, data_size, buf_size);
+        if (with_context) with_context(context, buf, data_size, buf_size);
+    }
+
+    void aus1_controller::clear_receiver() {
+        receiver = nullptr;
+        context_receiver = nullptr;
+        receiver_context = nullptr;
+    }
+
+    void aus1_controller::start_discovery(uint8_t mode, unsigned long current_time) {
+        aus1_discover_packet discover = { mode, discovery_window_ms };
+        uint8_t packet[AUS1_DISCOVER_PACKET_SIZE];
+        aus1_encode_discover(packet, &discover);
+
+        if (send_transmission(AUS1_GENERAL_CALL_ADDRESS, packet, AUS1_DISCOVER_PACKET_SIZE) != 0) return; // nobody listening
+
+        discovery_mode = mode;
+        discovery_started_ms = current_time;
+        state = aus1_controller_state::DISCOVERING;
+    }
+
+    void aus1_controller::receive_reply(int /* count */) {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_begin(&duty_cycle, micros());
+#endif
+
+        // Each reply is a write of its own, so a whole packet arrives at once
+        uint8_t packet[AUS1_ANNOUNCE_PACKET_SIZE];
+        uint8_t len = 0;
+        while (wire->available()) {
+            uint8_t byte = (uint8_t) wire->read();
+            if (len < AUS1_ANNOUNCE_PACKET_SIZE) packet[len++] = byte; // too long to be a reply
+        }
+
+        // Anything else is not a reply, and a full buffer stays full until the next update
+        if (len != 0 && aus1_discovery_reply_size(packet) == len && replies_size + len <= sizeof(replies)) {
+            memcpy(replies + replies_size, packet, len);
+            replies_size = replies_size + len; // volatile, so not `+=`, which C++20 deprecates
+        }
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_end(&duty_cycle, micros());
+#endif
+    }
+
+    void aus1_controller::collect_discovery_replies(unsigned long current_time) {
+        if (replies_size == 0) return;
+
+        // Take the replies in one go, so the callback cannot append halfway through
+        uint8_t pending[sizeof(replies)];
+        noInterrupts();
+        uint8_t pending_size = replies_size;
+        memcpy(pending, replies, pending_size);
+        replies_size = 0;
+        interrupts();
+
+        uint8_t read_loc = 0;
+        while (read_loc < pending_size) {
+            uint8_t size = aus1_discovery_reply_size(pending + read_loc); // whole packets only, checked on receipt
+
+            uint8_t address;
+            aus1_announce_packet announce = {};
+            if (size == AUS1_ANNOUNCE_PACKET_SIZE) {
+                announce = aus1_decode_announce(pending + read_loc);
+                address = announce.address;
+            } else {
+                address = aus1_decode_heartbeat(pending + read_loc);
+            }
+            read_loc += size;
+
+            if (address == 0) continue; // invalid packet
+
+            aus1_peripheral_entry *entry = nullptr;
+            for (uint8_t i = 0; i < peripheral_count; i++) {
+                if (peripherals[i].address == address) entry = &peripherals[i];
+            }
+
+            if (size == AUS1_ANNOUNCE_PACKET_SIZE) {
+                if (!entry) {
+                    if (peripheral_count == AUS1_MAX_PERIPHERALS) continue; // table full
+                    entry = &peripherals[peripheral_count++];
+                    entry->address = address;
+                }
+                entry->peripheral_type = announce.peripheral_type;
+                entry->peripheral_version = announce.peripheral_version;
+            }
+
+            // Heartbeats from peripherals that never announced carry nothing worth tracking
+            if (entry) entry->last_seen_ms = current_time;
+        }
+    }
+
+    bool aus1_controller::all_peripherals_seen_since(unsigned long since, unsigned long current_time) const {
+        for (uint8_t i = 0; i < peripheral_count; i++) {
+            if (current_time - peripherals[i].last_seen_ms > current_time - since) return false; // compare ages so wrapping is harmless
+        }
+        return true;
+    }
+
+    unsigned long aus1_controller::discovery_period() const {
+        // Each retry doubles the window, so 2^attempts windows cover them all
+        return (unsigned long) discovery_window_ms << AUS1_DISCOVERY_ATTEMPTS;
+    }
+
+    int aus1_controller::send_transmission(uint8_t address, uint8_t *buf, size_t len) {
+        wire->beginTransmission(address);
         wire->write(buf, len);
         return wire->endTransmission();
     }
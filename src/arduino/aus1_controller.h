@@ -24,6 +24,27 @@ extern "C" {
     #include "../aus1.h"
 }
 
+#include "../util/instance_table.h"
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+    #include "../util/duty_cycle.h"
+#endif
+
+// Largest number of clock rates the controller can tune between
+#define AUS1_MAX_CLOCK_RATES 8
+// Longest time, in tuning windows, to wait before probing a rate that failed again
+#define AUS1_MAX_CLOCK_BACKOFF 64
+// Largest number of peripherals tracked by discovery
+#define AUS1_MAX_PERIPHERALS 8
+// Slot window used for liveness checks until `discover()` picks one
+#define AUS1_DEFAULT_DISCOVERY_WINDOW_MS 16
+// Time between PING packets while idle, until `set_ping_interval()` picks one
+#define AUS1_DEFAULT_PING_INTERVAL_MS 20
+#ifndef AUS1_MAX_CONTROLLER_INSTANCES
+// Largest number of controllers receiving discovery replies at once, each on its own wire
+#define AUS1_MAX_CONTROLLER_INSTANCES 2
+#endif
+
 namespace superi2c {
     /**
      * @brief Defines the state of an AUS1 controller
@@ -32,6 +53,7 @@ namespace superi2c {
         AWAITING_PING_RESPONSE,
         AWAITING_START_OF_STREAM,
         RECEIVING_DATA,
+        DISCOVERING,
         IDLE
     };
 
@@ -39,14 +61,76 @@ namespace superi2c {
      * @brief A function that is called when data is received by a controller
      */
     typedef void (*receiver_function)(uint8_t *buf, size_t data_size, size_t buf_size);
+    /**
+     * @brief A function that is called with a caller-provided context when data is received by a controller
+     */
+    typedef void (*context_receiver_function)(void *context, uint8_t *buf, size_t data_size, size_t buf_size);
+
+    /**
+     * @brief Error statistics for one bus clock rate
+     */
+    struct aus1_clock_rate_stats {
+        /**
+         * @brief The clock rate in Hz
+         */
+        uint32_t rate;
+        /**
+         * @brief Transactions completed at this rate in the current window
+         */
+        uint16_t transactions;
+        /**
+         * @brief Transactions that failed (NACK, checksum mismatch, timeout) in the current window
+         */
+        uint16_t errors;
+        /**
+         * @brief Windows left before this rate may be probed again
+         */
+        uint8_t holdoff;
+        /**
+         * @brief The holdoff applied the next time this rate goes over budget
+         */
+        uint8_t backoff;
+    };
+
+    /**
+     * @brief A peripheral found by discovery
+     */
+    struct aus1_peripheral_entry {
+        /**
+         * @brief The I2C address the peripheral answers on
+         */
+        uint8_t address;
+        /**
+         * @brief The type the peripheral announced
+         */
+        uint32_t peripheral_type;
+        /**
+         * @brief The version the peripheral announced
+         */
+        uint16_t peripheral_version;
+        /**
+         * @brief The last millisecond an ANNOUNCE or HEARTBEAT was received from the peripheral
+         */
+        unsigned long last_seen_ms;
+    };
 
     class aus1_controller {
+        typedef instance_table<aus1_controller, AUS1_MAX_CONTROLLER_INSTANCES> instances;
+
+    public:
         /**
          * @brief Construct a new aus1 controller object
          * 
          * @param wire The I2C wire to take control of
          */
         explicit aus1_controller(TwoWire *wire);
+        /**
+         * @brief Stops receiving discovery replies and frees the data buffer
+         */
+        ~aus1_controller();
+
+        aus1_controller(const aus1_controller &) = delete;
+        aus1_controller &operator=(const aus1_controller &) = delete;
 
         /**
          * @brief Gets the connection status of the controller wire
@@ -63,12 +147,162 @@ namespace superi2c {
          */
         void set_timeout_period(unsigned long period);
 
+        /**
+         * @brief Sets how often an idle controller PINGs the peripheral, to notice it connect or go away
+         * @note Longer intervals let a tickless application sleep longer, but notice a new peripheral later
+         * 
+         * @param interval The interval in milliseconds
+         */
+        void set_ping_interval(unsigned long interval);
+
+        /**
+         * @brief Sets the address PINGs and data requests are sent to
+         * @note Discovery replies are written to `AUS1_I2C_ADDRESS`, which the controller's wire must listen on.
+         *       A new address disconnects the controller until a PING, sent at the next update, is answered from it.
+         *       Only change it while idle.
+         * 
+         * @param address The peripheral's I2C address, e.g. one found by `discover()`
+         */
+        void set_peripheral_address(uint8_t address);
+
+        /**
+         * @brief Broadcasts a DISCOVER packet so every listening peripheral announces itself
+         * @note Runs once the controller is idle. Peripherals must have general call reception enabled.
+         *       Replies arrive through the wire's receive callback, which the controller registers for itself,
+         *       so at most `AUS1_MAX_CONTROLLER_INSTANCES` controllers can discover at once.
+         * 
+         * @param window_ms The window peripherals spread their replies over. Wider windows collide less.
+         */
+        void discover(uint8_t window_ms = AUS1_DEFAULT_DISCOVERY_WINDOW_MS);
+        /**
+         * @brief Sets how often discovered peripherals are checked with a single broadcast heartbeat request
+         * 
+         * @param interval The interval in milliseconds, or 0 to stop checking
+         */
+        void set_liveness_interval(unsigned long interval);
+        /**
+         * @brief Gets the number of peripherals found by discovery
+         * 
+         * @return The number of entries in the peripheral table
+         */
+        size_t get_peripheral_count() const;
+        /**
+         * @brief Gets a peripheral found by discovery
+         * 
+         * @param index The index in the peripheral table
+         * @return The entry, or `nullptr` if out of range
+         */
+        const aus1_peripheral_entry *get_peripheral(size_t index) const;
+        /**
+         * @brief Whether a discovered peripheral answered recently
+         * 
+         * A peripheral is alive while it has been seen within one liveness interval, one discovery period and the timeout period.
+         * 
+         * @param index The index in the peripheral table
+         * @return Whether the peripheral is alive
+         */
+        bool peripheral_alive(size_t index) const;
+
         /**
          * @brief Requests data from the peripheral
+         * @note A request made while disconnected waits for the next PING to connect
          * 
          * @param receiver The function to call when requested data is received.
          */
         void request_data(receiver_function receiver);
+        /**
+         * @brief Requests data from the peripheral, passing `context` back to the receiver
+         * 
+         * @param receiver The function to call when requested data is received.
+         * @param context An opaque pointer handed to `receiver` unchanged
+         */
+        void request_data(context_receiver_function receiver, void *context);
+        /**
+         * @brief Abandons any pending or in-progress data request without calling its receiver
+         */
+        void cancel_request();
+
+        /**
+         * @brief Whether a data request is pending or in progress
+         * 
+         * @return Whether a receiver is waiting for data
+         */
+        bool has_receiver() const;
+
+        /**
+         * @brief Asks the peripheral for forward error correction on data chunks
+         * @note Takes effect from the next PING, and only if the peripheral supports it
+         * 
+         * @param enabled Whether to request FEC
+         */
+        void set_fec_enabled(bool enabled);
+        /**
+         * @brief Asks the peripheral to protect data with a different integrity check
+         * @note Takes effect from the next PING. Cheaper checks suit small, frequent payloads.
+         * 
+         * @param integrity An `AUS1_INTEGRITY_*` check
+         */
+        void set_integrity(uint8_t integrity);
+        /**
+         * @brief Gets the integrity check negotiated with the peripheral
+         * 
+         * @return An `AUS1_INTEGRITY_*` check
+         */
+        uint8_t get_integrity() const;
+        /**
+         * @brief Gets the capabilities negotiated with the peripheral
+         * 
+         * @return A mask of `AUS1_CAPABILITY_*` flags
+         */
+        uint8_t get_capabilities() const;
+        /**
+         * @brief Gets the number of bit errors corrected by FEC so far
+         * 
+         * @return The number of corrected bits
+         */
+        uint32_t get_corrected_bit_count() const;
+
+        /**
+         * @brief Lets the controller pick the fastest bus clock rate that stays within an error budget
+         * 
+         * The controller starts at the slowest rate. After every `window` transactions it moves up one rate
+         * while the error rate is within budget and falls back one rate when it is not. Rates that fail are
+         * probed again after an exponentially growing number of windows. Rates only change while idle.
+         * 
+         * Rates are applied with `TwoWire::setClock`, which cannot report failure. Where it does nothing, as over
+         * a Linux adapter (`i2c_dev`), tuning only changes what `get_clock_rate()` reports and should be left off.
+         * 
+         * @param rates The candidate rates in Hz, slowest first
+         * @param count The number of rates, at most `AUS1_MAX_CLOCK_RATES`
+         * @param error_budget The largest acceptable share of failed transactions, in parts per thousand
+         * @param window The number of transactions to judge a rate by
+         * @return Whether tuning was enabled
+         */
+        bool enable_clock_tuning(const uint32_t *rates, size_t count, uint16_t error_budget, uint16_t window);
+        /**
+         * @brief Stops tuning and keeps the current clock rate
+         */
+        void disable_clock_tuning();
+        /**
+         * @brief Gets the clock rate chosen by tuning
+         * 
+         * @return The rate in Hz last passed to the wire, which the bus may not actually run at
+         *         (see `enable_clock_tuning`), or 0 if tuning is disabled
+         */
+        uint32_t get_clock_rate() const;
+
+        /**
+         * @brief Gets the type reported by the connected peripheral
+         * 
+         * @return The peripheral type, or 0 if no peripheral has responded yet
+         */
+        uint32_t get_device_type() const;
+        /**
+         * @brief Gets the version reported by the connected peripheral
+         * 
+         * @return The peripheral version
+         */
+        uint16_t get_device_version() const;
 
         /**
          * @brief Get the state object
@@ -78,9 +312,33 @@ namespace superi2c {
         aus1_controller_state get_state() const;
 
         /**
-         * @brief Performs operations (reading, pinging, etc) that should be called every loop
+         * @brief Performs operations (reading, pinging, etc) that are due
+         * 
+         * The application may sleep until the returned delay has passed, or until one of `wake_events()` occurs.
+         * 
+         * @return The number of milliseconds until `update()` next needs to be called
+         */
+        unsigned long update();
+
+        /**
+         * @brief Gets the events that should wake the application before the delay returned by `update()` is up
+         * 
+         * @return A mask of `AUS1_WAKE_*` flags
          */
-        void update();
+        uint8_t wake_events() const;
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        /**
+         * @brief Gets the time spent inside `update()` and the Wire receive callback since the meter was last reset
+         * 
+         * @return The duty cycle meter
+         */
+        const duty_cycle_meter &get_duty_cycle() const;
+        /**
+         * @brief Restarts duty cycle measurement
+         */
+        void reset_duty_cycle();
+#endif
 
     private:
         /**
@@ -95,6 +353,10 @@ namespace superi2c {
          * @brief Whether a peripheral is connected
          */
         bool is_connected;
+        /**
+         * @brief The address PINGs and data requests are sent to
+         */
+        uint8_t peripheral_address;
         
         /**
          * @brief The type of connected peripheral
@@ -104,15 +366,39 @@ namespace superi2c {
          * @brief The version of the connected peripheral
          */
         uint16_t device_version;
+        /**
+         * @brief The capabilities asked for in PING packets
+         */
+        uint8_t requested_capabilities;
+        /**
+         * @brief The capabilities granted by the peripheral
+         */
+        uint8_t capabilities;
+        /**
+         * @brief The integrity check asked for in PING packets
+         */
+        uint8_t requested_integrity;
+        /**
+         * @brief The integrity check the peripheral agreed to use
+         */
+        uint8_t integrity;
 
         /**
          * @brief The function to be called when data is received after a request from a peripheral. `nullptr` when no data is being requested.
          */
         receiver_function receiver;
         /**
-         * @brief The checksum CRC32 hash for the data packets
+         * @brief The context-aware variant of `receiver`. `nullptr` when not in use.
+         */
+        context_receiver_function context_receiver;
+        /**
+         * @brief The context passed to `context_receiver`
+         */
+        void *receiver_context;
+        /**
+         * @brief The integrity check value for the data packets
          */
-        uint32_t data_crc_hash;
+        uint32_t data_check_value;
         /**
          * @brief Size of the data being receieved
          */
@@ -130,12 +416,40 @@ namespace superi2c {
          * @brief Current location of byte writer in the data buffer
          */
         size_t data_loc;
+        /**
+         * @brief The number of chunks in the current stream
+         */
+        size_t chunk_count;
+        /**
+         * @brief The number of chunks requested from the peripheral so far
+         */
+        size_t chunks_requested;
+        /**
+         * @brief The number of received chunks that have been decoded and fed to the integrity check
+         */
+        size_t chunks_processed;
+        /**
+         * @brief The running integrity check over the chunks processed so far
+         */
+        uint32_t integrity_state;
+        /**
+         * @brief Whether a chunk of the current stream had more errors than FEC can correct
+         */
+        bool chunk_uncorrectable;
+        /**
+         * @brief The number of bit errors corrected by FEC so far
+         */
+        uint32_t corrected_bits;
 
         /**
          * @brief The time it takes for the controller to time out and assume the peripheral to be disconnected
          */
         unsigned long timeout_period;
 
+        /**
+         * @brief The time between PING packets while idle
+         */
+        unsigned long ping_interval;
         /**
          * @brief The previous millisecond the peripheral was pinged
          */
@@ -144,22 +458,200 @@ namespace superi2c {
          * @brief The last millisecond data was receieved by the controller
          */
         unsigned long last_bytes_received_ms;
+        /**
+         * @brief The last millisecond data nobody asked for was received while idle
+         */
+        unsigned long last_stray_bytes_ms;
+
+        /**
+         * @brief Statistics for each candidate clock rate
+         */
+        aus1_clock_rate_stats clock_rates[AUS1_MAX_CLOCK_RATES];
+        /**
+         * @brief The number of candidate clock rates. 0 when tuning is disabled.
+         */
+        uint8_t clock_rate_count;
+        /**
+         * @brief The index of the clock rate in use
+         */
+        uint8_t clock_index;
+        /**
+         * @brief The largest acceptable share of failed transactions, in parts per thousand
+         */
+        uint16_t clock_error_budget;
+        /**
+         * @brief The number of transactions to judge a rate by
+         */
+        uint16_t clock_window;
+
+        /**
+         * @brief Peripherals found by discovery
+         */
+        aus1_peripheral_entry peripherals[AUS1_MAX_PERIPHERALS];
+        /**
+         * @brief The number of entries in `peripherals`
+         */
+        uint8_t peripheral_count;
+        /**
+         * @brief Whether `discover()` asked for a broadcast that has not been sent yet
+         */
+        bool discovery_requested;
+        /**
+         * @brief The mode of the DISCOVER packet being answered
+         */
+        uint8_t discovery_mode;
+        /**
+         * @brief The window peripherals spread their replies over
+         */
+        uint8_t discovery_window_ms;
+        /**
+         * @brief The millisecond the latest DISCOVER packet was broadcast
+         */
+        unsigned long discovery_started_ms;
+        /**
+         * @brief Discovery replies received by the Wire callback, waiting for the next update
+         */
+        uint8_t replies[AUS1_ANNOUNCE_PACKET_SIZE * AUS1_MAX_PERIPHERALS];
+        /**
+         * @brief The number of bytes in `replies`. Written by the Wire callback.
+         */
+        volatile uint8_t replies_size;
+        /**
+         * @brief The slot routing the wire's receive callback to this controller, or `AUS1_MAX_CONTROLLER_INSTANCES` if none was free
+         */
+        uint8_t instance_slot;
+        /**
+         * @brief The time between heartbeat broadcasts. 0 when liveness checks are disabled.
+         */
+        unsigned long liveness_interval;
+        /**
+         * @brief The previous millisecond a liveness check was started
+         */
+        unsigned long last_liveness_ms;
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        /**
+         * @brief Measures the time spent inside `update()` and the Wire receive callback
+         */
+        duty_cycle_meter duty_cycle;
+#endif
         
+        /**
+         * @brief Runs the state machine
+         * 
+         * @param current_time The current time in milliseconds
+         */
+        void process(unsigned long current_time);
+        /**
+         * @brief Computes the delay returned by `update()`
+         * 
+         * @param current_time The current time in milliseconds
+         * @return The number of milliseconds until the state machine next needs to run
+         */
+        unsigned long time_until_next_update(unsigned long current_time) const;
+        /**
+         * @brief Computes the time until `current_time - since > period` holds
+         * 
+         * @param current_time The current time in milliseconds
+         * @param since The start of the period
+         * @param period The length of the period
+         * @return The remaining time in milliseconds
+         */
+        static unsigned long time_until(unsigned long current_time, unsigned long since, unsigned long period);
+        /**
+         * @brief Reads the next chunk once the previous one has been drained
+         * 
+         * @return Whether the read went through, or was not due yet
+         */
+        bool request_next_chunk();
+        /**
+         * @brief Drops the connection and any data request after the peripheral failed to acknowledge a transfer
+         * 
+         * @param current_time The current time in milliseconds
+         */
+        void lose_peripheral(unsigned long current_time);
+        /**
+         * @brief Decodes a received chunk and feeds its payload to the running integrity check
+         * 
+         * @param index The index of the chunk
+         */
+        void process_chunk(size_t index);
         /**
          * @brief Deletes the data buffer, cleans up, and remakes it
          * 
          * @param new_buffer_size The size of the new data buffer
          */
         void reset(size_t new_buffer_size);
+        /**
+         * @brief Counts a transaction towards the current clock rate's error rate
+         * 
+         * @param ok Whether the transaction succeeded
+         */
+        void record_transaction(bool ok);
+        /**
+         * @brief Moves to a faster or slower clock rate once the current window is complete
+         */
+        void tune_clock();
+        /**
+         * @brief Switches the bus to a candidate clock rate
+         * 
+         * @param index The index of the rate
+         */
+        void set_clock_index(uint8_t index);
+        /**
+         * @brief Hands received data to whichever receiver was registered, then clears it
+         * 
+         * @param buf The received data, or `nullptr` if it failed verification
+         * @param data_size The size of the payload
+         * @param buf_size The size of the buffer
+         */
+        void deliver(uint8_t *buf, size_t data_size, size_t buf_size);
+        /**
+         * @brief Drops any registered receiver without calling it
+         */
+        void clear_receiver();
+        /**
+         * @brief Broadcasts a DISCOVER packet and starts collecting replies
+         * 
+         * @param mode An `AUS1_DISCOVER_MODE_*` mode
+         * @param current_time The current time in milliseconds
+         */
+        void start_discovery(uint8_t mode, unsigned long current_time);
+        /**
+         * @brief Keeps a discovery reply written to the controller. Called from the Wire receive callback.
+         * 
+         * @param count The number of bytes written
+         */
+        void receive_reply(int count);
+        /**
+         * @brief Records the ANNOUNCE and HEARTBEAT packets received since the last update
+         * 
+         * @param current_time The current time in milliseconds
+         */
+        void collect_discovery_replies(unsigned long current_time);
+        /**
+         * @brief Whether every discovered peripheral has replied since a given time
+         * 
+         * @param since The start of the period
+         * @param current_time The current time in milliseconds
+         * @return Whether every entry was seen at or after `since`
+         */
+        bool all_peripherals_seen_since(unsigned long since, unsigned long current_time) const;
+        /**
+         * @brief Gets the time replies to a DISCOVER packet are collected for, covering every retry
+         * 
+         * @return The time in milliseconds
+         */
+        unsigned long discovery_period() const;
         /**
          * @brief Transmits some data to an AUS1 device across an I2C wire
          * 
-         * @param wire The wire
+         * @param address The address of the device
          * @param buf The data to write
          * @param len The length of the data
          * 
          * @return The status of the transmission
          */
-        int send_transmission(uint8_t *buf, size_t len);
+        int send_transmission(uint8_t address, uint8_t *buf, size_t len);
     };
 }
@@ -19,9 +19,9 @@
 #include "aus1_peripheral.h"
 
 #include "../aus1.h"
-#include "../util/crc32.h"
 
 #include <cstdint>
+#include <cstring>
 
 #define WIRE_TIMEOUT_ERR_CODE 5
 
@@ -29,59 +29,223 @@ namespace superi2c {
     aus1_peripheral::aus1_peripheral(TwoWire *wire,
                                      uint32_t peripheral_type,
                                      uint16_t peripheral_version,
-                                     provide_data_response *data_response)
+                                     provide_data_response data_response)
         : wire(wire),
           state(aus1_peripheral_state::IDLE),
           peripheral_type(peripheral_type),
-          peripheral_version(peripheral_version) {
-        
-        wire->onRequest([peripheral_type, peripheral_version, this]() { // presumably a data request
-            data_being_sent = new buf(data());
+          peripheral_version(peripheral_version),
+          supported_capabilities(0),
+          capabilities(0),
+          integrity(AUS1_INTEGRITY_CRC32),
+          address(AUS1_I2C_ADDRESS),
+          discovery_mode(AUS1_DISCOVER_MODE_ANNOUNCE),
+          discovery_attempts(0),
+          discovery_window_ms(0),
+          discovery_since_ms(0),
+          discovery_delay_ms(0),
+          reply_size(0),
+          stream_requested(false),
+          data(data_response),
+          data_being_sent(nullptr),
+          data_loc(0),
+          instance_slot(instances::claim(this)) {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_reset(&duty_cycle, micros());
+#endif
 
-            uint32_t hash = crc32buf(data_being_sent->data, data_being_sent->size);
+        wire->onRequest(instances::trampoline<&aus1_peripheral::answer_request>(instance_slot));
+        wire->onReceive(instances::int_trampoline<&aus1_peripheral::receive_packet>(instance_slot));
+    }
+
+    aus1_peripheral::~aus1_peripheral() {
+        if (instance_slot != AUS1_MAX_PERIPHERAL_INSTANCES) {
+            wire->onRequest(nullptr);
+            wire->onReceive(nullptr);
+        }
+        instances::release(instance_slot);
+        end_stream();
+    }
+
+    void aus1_peripheral::answer_request() {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_begin(&duty_cycle, micros());
+#endif
 
-            aus1_start_of_stream_packet packet = { data_being_sent->size, hash };
-            uint8_t buf[] = new uint8_t[AUS1_START_OF_STREAM_PACKET_SIZE];
-            aus1_encode_start_of_stream(buf, &packet);
-            this->send_transmission(buf, AUS1_START_OF_STREAM_PACKET_SIZE);
+        // Reads are answered from inside the callback, as the bytes written here are what the controller reads
+        if (reply_size) {
+            wire->write(reply, reply_size);
+            reply_size = 0;
+        } else if (stream_requested) {
+            stream_requested = false;
+            start_stream();
+        } else if (data_being_sent) {
+            send_next_chunk();
+        }
+        // Otherwise nothing was asked for, and the controller sees a short read
 
-            delete[] buf;
-        });
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_end(&duty_cycle, micros());
+#endif
     }
 
-    void aus1_peripheral::update() {
-        if (data_being_sent) { // currently sending data
-            if (data_loc < data_being_sent->size - 32) { // last segment of data, need a special size for the buffer
-                send_transmission(data_being_sent->data + data_loc, data_being_sent->size - data_loc - 32);
-                delete data_being_sent;
-                data_being_sent = nullptr;
-                data_loc = 0;
-            } else { // middle of the packet, can send full 32 bytes safely
-                send_transmission(data_being_sent->data + data_loc, AUS1_DATA_PACKET_SIZE);
-                data_loc += AUS1_DATA_PACKET_SIZE;
-            }
-        } else if (wire->available() == AUS1_PING_PACKET_SIZE) { // currently receiving data
-            // decode ping packet
-            uint8_t ping_byte = (uint8_t) wire->read();
-            if (!aus1_decode_ping(&ping_byte)) {
-                return;
-            }
-
-            // send packet
-            aus1_ping_response_packet packet = { peripheral_type, peripheral_version };
-            uint8_t *bres = new uint8_t[AUS1_PING_RESPONSE_PACKET_SIZE];
-            aus1_encode_ping_response(bres, &packet);
-            this->send_transmission(bres, AUS1_PING_RESPONSE_PACKET_SIZE);
-
-            delete[] bres;
-        } else { // more data in wire than there should be
-            // clear buffer; there shouldn't be data besides a one-byte ping packet
-            while (wire->available()) {
-                wire->read();
-            }
+    void aus1_peripheral::receive_packet(int /* count */) {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_begin(&duty_cycle, micros());
+#endif
+
+        // PING and DISCOVER are the largest packets a controller writes
+        uint8_t packet[AUS1_PING_PACKET_SIZE];
+        size_t len = 0;
+        while (wire->available()) {
+            uint8_t byte = (uint8_t) wire->read();
+            if (len < AUS1_PING_PACKET_SIZE) packet[len++] = byte; // more data than there should be is discarded
+        }
+
+        aus1_ping_packet ping;
+        aus1_discover_packet discover;
+        if (len == AUS1_STREAM_REQUEST_PACKET_SIZE && aus1_decode_stream_request(packet)) {
+            // Marks a new stream, so whatever is left of an abandoned one is dropped rather than sent in its place
+            end_stream();
+            reply_size = 0;
+            stream_requested = true;
+        } else if (len == AUS1_PING_PACKET_SIZE && aus1_decode_ping(packet, &ping)) {
+            stream_requested = false;
+            respond_to_ping(ping);
+        } else if (len == AUS1_DISCOVER_PACKET_SIZE && aus1_decode_discover(packet, &discover)) {
+            discovery_mode = discover.mode;
+            discovery_window_ms = discover.window_ms;
+            schedule_discovery_reply(millis());
+            discovery_attempts = AUS1_DISCOVERY_ATTEMPTS;
         }
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_end(&duty_cycle, micros());
+#endif
+    }
+
+    void aus1_peripheral::start_stream() {
+        buf response = data();
+        delete data_being_sent;
+        data_being_sent = new buf{ response.data, response.size };
+        response.data = nullptr; // ownership moved to data_being_sent
+        data_loc = 0;
+
+        // The check is picked per stream from what the latest PING negotiated
+        aus1_start_of_stream_packet packet = {
+            (uint16_t) data_being_sent->size,
+            aus1_integrity_compute(integrity, data_being_sent->data, data_being_sent->size),
+            integrity
+        };
+        uint8_t bsos[AUS1_START_OF_STREAM_PACKET_SIZE];
+        aus1_encode_start_of_stream(bsos, &packet);
+        wire->write(bsos, aus1_start_of_stream_size(integrity));
+    }
+
+    unsigned long aus1_peripheral::update() {
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_begin(&duty_cycle, micros());
+#endif
+
+        process();
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_end(&duty_cycle, micros());
+#endif
+        // Reads and writes are handled by the Wire callbacks; only discovery replies are sent from update()
+        if (discovery_attempts == 0) return AUS1_NO_DEADLINE;
+
+        unsigned long elapsed = millis() - discovery_since_ms;
+        return elapsed >= discovery_delay_ms ? 0 : discovery_delay_ms - elapsed;
+    }
+
+    uint8_t aus1_peripheral::wake_events() const {
+        return discovery_attempts ? (AUS1_WAKE_DEADLINE | AUS1_WAKE_BUS) : AUS1_WAKE_BUS;
+    }
+
+    void aus1_peripheral::set_capabilities(uint8_t supported) { this->supported_capabilities = supported; }
+
+    void aus1_peripheral::set_address(uint8_t address) { this->address = address; }
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+    const duty_cycle_meter &aus1_peripheral::get_duty_cycle() const { return duty_cycle; }
+
+    void aus1_peripheral::reset_duty_cycle() { duty_cycle_reset(&duty_cycle, micros()); }
+#endif
+
+    void aus1_peripheral::process() {
+        if (discovery_attempts && millis() - discovery_since_ms >= discovery_delay_ms) {
+            send_discovery_reply(millis());
+        }
+    }
+
+    void aus1_peripheral::respond_to_ping(const aus1_ping_packet &ping) {
+        // grant whatever was asked for that this peripheral supports; applies to streams from now on
+        capabilities = ping.capabilities & supported_capabilities;
+        integrity = aus1_integrity_size(ping.integrity) ? ping.integrity : AUS1_INTEGRITY_CRC32;
+
+        // answered by the controller's next read
+        aus1_ping_response_packet packet = { peripheral_type, peripheral_version, capabilities, integrity };
+        aus1_encode_ping_response(reply, &packet);
+        reply_size = AUS1_PING_RESPONSE_PACKET_SIZE;
+    }
+
+    void aus1_peripheral::schedule_discovery_reply(unsigned long current_time) {
+        discovery_since_ms = current_time;
+        discovery_delay_ms = discovery_window_ms ? random(discovery_window_ms) : 0;
+    }
+
+    void aus1_peripheral::send_discovery_reply(unsigned long current_time) {
+        uint8_t packet[AUS1_ANNOUNCE_PACKET_SIZE];
+        size_t len;
+        if (discovery_mode == AUS1_DISCOVER_MODE_HEARTBEAT) {
+            aus1_encode_heartbeat(packet, address);
+            len = AUS1_HEARTBEAT_PACKET_SIZE;
+        } else {
+            aus1_announce_packet announce = { address, peripheral_type, peripheral_version };
+            aus1_encode_announce(packet, &announce);
+            len = AUS1_ANNOUNCE_PACKET_SIZE;
+        }
+
+        discovery_attempts = discovery_attempts - 1; // volatile, so not `--`, which C++20 deprecates
+        if (send_transmission(packet, len) == 0 || discovery_attempts == 0) {
+            discovery_attempts = 0;
+            return;
+        }
+
+        // Lost arbitration or was NACKed, most likely to another peripheral picking the same slot; spread out further
+        discovery_window_ms = discovery_window_ms ? discovery_window_ms * 2 : 1;
+        schedule_discovery_reply(current_time);
     }
     
+    void aus1_peripheral::send_next_chunk() {
+        uint8_t chunk_data_size = aus1_chunk_data_size(capabilities);
+        size_t remaining = data_being_sent->size - data_loc;
+        size_t len = remaining < chunk_data_size ? remaining : chunk_data_size;
+
+        // the final chunk is zero-padded so every chunk has the same size on the wire
+        uint8_t chunk[AUS1_DATA_PACKET_SIZE] = {0};
+        if (capabilities & AUS1_CAPABILITY_FEC) {
+            uint8_t payload[AUS1_FEC_CHUNK_DATA_SIZE] = {0};
+            memcpy(payload, data_being_sent->data + data_loc, len);
+            aus1_fec_encode_chunk(chunk, payload);
+        } else {
+            memcpy(chunk, data_being_sent->data + data_loc, len);
+        }
+
+        wire->write(chunk, AUS1_DATA_PACKET_SIZE);
+        data_loc += len;
+
+        if (data_loc >= data_being_sent->size) { // last chunk sent
+            end_stream();
+        }
+    }
+
+    void aus1_peripheral::end_stream() {
+        delete data_being_sent;
+        data_being_sent = nullptr;
+        data_loc = 0;
+    }
+
     int aus1_peripheral::send_transmission(uint8_t *buf, size_t len) {
         wire->beginTransmission(AUS1_I2C_ADDRESS);
         wire->write(buf, len);
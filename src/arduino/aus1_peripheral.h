@@ -23,6 +23,17 @@ extern "C" {
     #include "../aus1.h"
 }
 
+#include "../util/instance_table.h"
+
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+    #include "../util/duty_cycle.h"
+#endif
+
+#ifndef AUS1_MAX_PERIPHERAL_INSTANCES
+// Largest number of peripherals active at once in one program, each on its own wire
+#define AUS1_MAX_PERIPHERAL_INSTANCES 2
+#endif
+
 namespace superi2c {
     enum class aus1_peripheral_state {
         SENDING_DATA,
@@ -41,20 +52,74 @@ namespace superi2c {
     typedef buf (*provide_data_response)();
 
     class aus1_peripheral {
+        typedef instance_table<aus1_peripheral, AUS1_MAX_PERIPHERAL_INSTANCES> instances;
+
+    public:
         /**
          * @brief Construct a new aus1 peripheral object
+         * @note At most `AUS1_MAX_PERIPHERAL_INSTANCES` peripherals may be active at a time, as Wire callbacks
+         *       carry no context and are routed through a fixed table; any more never answer
          * 
          * @param wire The I2C wire to take control of
+         * @param peripheral_type A numeric ID for the type of device
+         * @param peripheral_version A numeric ID for the current version of the device
+         * @param data_response The function providing the payload for each data request
          */
         explicit aus1_peripheral(TwoWire *wire,
                                  uint32_t peripheral_type,
                                  uint16_t peripheral_version,
-                                 provide_data_response *data_response);
+                                 provide_data_response data_response);
+        /**
+         * @brief Stops answering Wire callbacks and drops any payload being sent
+         */
+        ~aus1_peripheral();
+
+        aus1_peripheral(const aus1_peripheral &) = delete;
+        aus1_peripheral &operator=(const aus1_peripheral &) = delete;
+
+        /**
+         * @brief Performs operations that are due
+         * 
+         * @return The number of milliseconds until `update()` next needs to be called,
+         *         or `AUS1_NO_DEADLINE` if only bus activity can create more work
+         */
+        unsigned long update();
+
+        /**
+         * @brief Sets the optional features this peripheral offers to controllers
+         * 
+         * @param supported A mask of `AUS1_CAPABILITY_*` flags
+         */
+        void set_capabilities(uint8_t supported);
+
+        /**
+         * @brief Sets the address this peripheral reports in ANNOUNCE and HEARTBEAT packets
+         * @note The application must begin the wire on this address and enable general call reception
+         *       (e.g. by setting bit 0 of `TWAR` on AVR) for discovery to reach it
+         * 
+         * @param address The I2C address the wire was begun on
+         */
+        void set_address(uint8_t address);
+
+        /**
+         * @brief Gets the events that should wake the application before the delay returned by `update()` is up
+         * 
+         * @return A mask of `AUS1_WAKE_*` flags
+         */
+        uint8_t wake_events() const;
 
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        /**
+         * @brief Gets the time spent inside `update()` and the Wire callbacks since the meter was last reset
+         * 
+         * @return The duty cycle meter
+         */
+        const duty_cycle_meter &get_duty_cycle() const;
         /**
-         * @brief Performs operations that should be called every loop
+         * @brief Restarts duty cycle measurement
          */
-        void update();
+        void reset_duty_cycle();
+#endif
 
     private:
         TwoWire* wire;
@@ -63,10 +128,115 @@ namespace superi2c {
         uint32_t peripheral_type;
         uint16_t peripheral_version;
 
+        /**
+         * @brief The capabilities this peripheral offers
+         */
+        uint8_t supported_capabilities;
+        /**
+         * @brief The capabilities granted to the controller in the latest PING-RESPONSE
+         */
+        uint8_t capabilities;
+        /**
+         * @brief The integrity check agreed to in the latest PING-RESPONSE
+         */
+        uint8_t integrity;
+
+        /**
+         * @brief The address reported to discovery
+         */
+        uint8_t address;
+        /**
+         * @brief The mode of the DISCOVER packet being answered
+         */
+        volatile uint8_t discovery_mode;
+        /**
+         * @brief Attempts left to answer the latest DISCOVER packet. 0 when none is pending.
+         */
+        volatile uint8_t discovery_attempts;
+        /**
+         * @brief The window the next reply is spread over, doubled after every collision
+         */
+        volatile unsigned long discovery_window_ms;
+        /**
+         * @brief The millisecond the reply backoff started
+         */
+        volatile unsigned long discovery_since_ms;
+        /**
+         * @brief The randomly picked time to wait before replying
+         */
+        volatile unsigned long discovery_delay_ms;
+
+        /**
+         * @brief The PING-RESPONSE to answer the next read with
+         */
+        uint8_t reply[AUS1_PING_RESPONSE_PACKET_SIZE];
+        /**
+         * @brief The size of `reply`. 0 when there is none.
+         */
+        uint8_t reply_size;
+        /**
+         * @brief Whether the next read should be answered with a START-OF-STREAM
+         */
+        bool stream_requested;
+
         provide_data_response data;
         buf* data_being_sent;
         size_t data_loc;
 
+#ifdef AUS1_MEASURE_DUTY_CYCLE
+        duty_cycle_meter duty_cycle;
+#endif
+
+        /**
+         * @brief The slot routing Wire callbacks to this peripheral, or `AUS1_MAX_PERIPHERAL_INSTANCES` if none was free
+         */
+        uint8_t instance_slot;
+
+        /**
+         * @brief Answers a read with whatever the latest write asked for. Called from the Wire request callback.
+         */
+        void answer_request();
+        /**
+         * @brief Decodes a packet written by the controller. Called from the Wire receive callback.
+         * 
+         * @param count The number of bytes written
+         */
+        void receive_packet(int count);
+        /**
+         * @brief Fetches a payload and answers with its START-OF-STREAM packet
+         */
+        void start_stream();
+        /**
+         * @brief Sends discovery replies that are due
+         */
+        void process();
+        /**
+         * @brief Answers with the next chunk of the payload, padded to `AUS1_DATA_PACKET_SIZE`
+         */
+        void send_next_chunk();
+        /**
+         * @brief Drops the payload being sent
+         */
+        void end_stream();
+        /**
+         * @brief Prepares the PING-RESPONSE for a PING packet
+         * 
+         * @param ping The decoded PING packet
+         */
+        void respond_to_ping(const aus1_ping_packet &ping);
+        /**
+         * @brief Picks a random slot in the window to answer discovery in
+         * 
+         * @param current_time The current time in milliseconds
+         */
+        void schedule_discovery_reply(unsigned long current_time);
+        /**
+         * @brief Sends an ANNOUNCE or HEARTBEAT packet, backing off and retrying if it collides
+         * 
+         * @param current_time The current time in milliseconds
+         */
+        void send_discovery_reply(unsigned long current_time);
+
         /**
          * @brief Transmits some data to an AUS1 device across an I2C wire
          * 
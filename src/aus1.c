@@ -20,6 +20,13 @@
 
 #pragma once
 
+#include "util/crc32.h"
+#include "util/crc16.h"
+#include "util/crc8.h"
+#include "util/fletcher16.h"
+
+#include <string.h>
+
 #ifdef _WIN32
     #include <winsock2.h>
 #else
@@ -30,18 +37,39 @@
 #define AUS1_TYPE_PING_FIELD            0xA0
 #define AUS1_TYPE_PING_RESPONSE_FIELD   0xA1
 #define AUS1_TYPE_START_OF_STREAM_FIELD 0xA2
+#define AUS1_TYPE_DISCOVER_FIELD        0xA3
+#define AUS1_TYPE_ANNOUNCE_FIELD        0xA4
+#define AUS1_TYPE_HEARTBEAT_FIELD       0xA5
+#define AUS1_TYPE_STREAM_REQUEST_FIELD  0xA6
 
-void aus1_encode_ping(uint8_t *buf) {
+void write_uint16(uint8_t *buf, uint16_t val);
+void write_uint16_raw(uint8_t *buf, uint16_t val);
+void write_uint32(uint8_t *buf, uint32_t val);
+void write_uint32_raw(uint8_t *buf, uint32_t val);
+uint16_t read_uint16(uint8_t *buf);
+uint16_t read_uint16_raw(uint8_t *buf);
+uint32_t read_uint32(uint8_t *buf);
+uint32_t read_uint32_raw(uint8_t *buf);
+
+void aus1_encode_ping(uint8_t *buf, const aus1_ping_packet *packet) {
     buf[0] = AUS1_TYPE_PING_FIELD;
+    buf[1] = packet->capabilities;
+    buf[2] = packet->integrity;
 }
-bool aus1_decode_ping(uint8_t *buf) {
-    return buf[0] == AUS1_TYPE_PING_FIELD;
+bool aus1_decode_ping(uint8_t *buf, aus1_ping_packet *packet) {
+    if (buf[0] != AUS1_TYPE_PING_FIELD) return false;
+
+    packet->capabilities = buf[sizeof(uint8_t) /* packet type */];
+    packet->integrity = buf[sizeof(uint8_t) /* packet type */ + sizeof(uint8_t) /* capabilities */];
+    return true;
 }
 
 void aus1_encode_ping_response(uint8_t *buf, const aus1_ping_response_packet *packet) {
     buf[0] = AUS1_TYPE_PING_RESPONSE_FIELD;
     write_uint32(buf + sizeof(uint8_t) /* packet type */, packet->peripheral_type);
     write_uint16(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint32_t) /* peripheral type */, packet->peripheral_version);
+    buf[sizeof(uint8_t) /* packet type */ + sizeof(uint32_t) /* peripheral type */ + sizeof(uint16_t) /* peripheral version */] = packet->capabilities;
+    buf[sizeof(uint8_t) /* packet type */ + sizeof(uint32_t) /* peripheral type */ + sizeof(uint16_t) /* peripheral version */ + sizeof(uint8_t) /* capabilities */] = packet->integrity;
 }
 aus1_ping_response_packet aus1_decode_ping_response(uint8_t *buf) {
     aus1_ping_response_packet packet = {0};
@@ -49,25 +77,227 @@ aus1_ping_response_packet aus1_decode_ping_response(uint8_t *buf) {
 
     packet.peripheral_type = read_uint32(buf + sizeof(uint8_t) /* packet type */);
     packet.peripheral_version = read_uint16(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint32_t) /* peripheral type */);
+    packet.capabilities = buf[sizeof(uint8_t) /* packet type */ + sizeof(uint32_t) /* peripheral type */ + sizeof(uint16_t) /* peripheral version */];
+    packet.integrity = buf[sizeof(uint8_t) /* packet type */ + sizeof(uint32_t) /* peripheral type */ + sizeof(uint16_t) /* peripheral version */ + sizeof(uint8_t) /* capabilities */];
 
     return packet;
 }
 
+void aus1_encode_stream_request(uint8_t *buf) {
+    buf[0] = AUS1_TYPE_STREAM_REQUEST_FIELD;
+}
+bool aus1_decode_stream_request(uint8_t *buf) {
+    return buf[0] == AUS1_TYPE_STREAM_REQUEST_FIELD;
+}
+
 void aus1_encode_start_of_stream(uint8_t *buf, const aus1_start_of_stream_packet *packet) {
     buf[0] = AUS1_TYPE_START_OF_STREAM_FIELD;
-    write_uint16_raw(buf + sizeof(uint16_t) /* packet type */, packet->data_size);
-    memcpy(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint16_t) /* data size */, &(packet->crc_hash), CRC_HASH_SIZE);
+    write_uint16_raw(buf + sizeof(uint8_t) /* packet type */, packet->data_size);
+
+    uint8_t *check = buf + sizeof(uint8_t) /* packet type */ + sizeof(uint16_t) /* data size */;
+    switch (aus1_integrity_size(packet->integrity)) {
+        case 4: write_uint32_raw(check, packet->check_value); break;
+        case 2: write_uint16_raw(check, (uint16_t) packet->check_value); break;
+        case 1: check[0] = (uint8_t) packet->check_value; break;
+    }
 }
-aus1_start_of_stream_packet aus1_decode_start_of_stream(uint8_t *buf) {
+aus1_start_of_stream_packet aus1_decode_start_of_stream(uint8_t *buf, uint8_t integrity) {
     aus1_start_of_stream_packet packet = {0};
     if (buf[0] != AUS1_TYPE_START_OF_STREAM_FIELD) return packet;
 
     packet.data_size = read_uint16_raw(buf + sizeof(uint8_t) /* packet type */);
-    memcpy(&(packet.crc_hash), buf + sizeof(uint8_t) /* packet type */ + sizeof(uint16_t) /* data size */, CRC_HASH_SIZE);
+    packet.integrity = integrity;
+
+    uint8_t *check = buf + sizeof(uint8_t) /* packet type */ + sizeof(uint16_t) /* data size */;
+    switch (aus1_integrity_size(integrity)) {
+        case 4: packet.check_value = read_uint32_raw(check); break;
+        case 2: packet.check_value = read_uint16_raw(check); break;
+        case 1: packet.check_value = check[0]; break;
+    }
+
+    return packet;
+}
+uint8_t aus1_start_of_stream_size(uint8_t integrity) {
+    return sizeof(uint8_t) /* packet type */ + sizeof(uint16_t) /* data size */ + aus1_integrity_size(integrity);
+}
+
+uint8_t aus1_integrity_size(uint8_t integrity) {
+    switch (integrity) {
+        case AUS1_INTEGRITY_CRC32:       return sizeof(uint32_t);
+        case AUS1_INTEGRITY_CRC16_CCITT: return sizeof(uint16_t);
+        case AUS1_INTEGRITY_CRC8:        return sizeof(uint8_t);
+        case AUS1_INTEGRITY_FLETCHER16:  return sizeof(uint16_t);
+        default:                         return 0;
+    }
+}
+uint32_t aus1_integrity_init(uint8_t integrity) {
+    switch (integrity) {
+        case AUS1_INTEGRITY_CRC32:       return 0xFFFFFFFF;
+        case AUS1_INTEGRITY_CRC16_CCITT: return 0xFFFF;
+        default:                         return 0;
+    }
+}
+uint32_t aus1_integrity_update(uint8_t integrity, uint32_t state, const uint8_t *buf, size_t len) {
+    switch (integrity) {
+        case AUS1_INTEGRITY_CRC32:       return crc32_update(state, buf, len);
+        case AUS1_INTEGRITY_CRC16_CCITT: return crc16_update((uint16_t) state, buf, len);
+        case AUS1_INTEGRITY_CRC8:        return crc8_update((uint8_t) state, buf, len);
+        case AUS1_INTEGRITY_FLETCHER16:  return fletcher16_update((uint16_t) state, buf, len);
+        default:                         return state;
+    }
+}
+uint32_t aus1_integrity_final(uint8_t integrity, uint32_t state) {
+    return integrity == AUS1_INTEGRITY_CRC32 ? ~state : state;
+}
+uint32_t aus1_integrity_compute(uint8_t integrity, const uint8_t *buf, size_t len) {
+    return aus1_integrity_final(integrity, aus1_integrity_update(integrity, aus1_integrity_init(integrity), buf, len));
+}
+
+void aus1_encode_discover(uint8_t *buf, const aus1_discover_packet *packet) {
+    buf[0] = AUS1_TYPE_DISCOVER_FIELD;
+    buf[1] = packet->mode;
+    buf[2] = packet->window_ms;
+}
+bool aus1_decode_discover(uint8_t *buf, aus1_discover_packet *packet) {
+    if (buf[0] != AUS1_TYPE_DISCOVER_FIELD) return false;
+
+    packet->mode = buf[sizeof(uint8_t) /* packet type */];
+    packet->window_ms = buf[sizeof(uint8_t) /* packet type */ + sizeof(uint8_t) /* mode */];
+    return true;
+}
+
+void aus1_encode_announce(uint8_t *buf, const aus1_announce_packet *packet) {
+    buf[0] = AUS1_TYPE_ANNOUNCE_FIELD;
+    buf[1] = packet->address;
+    write_uint32(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint8_t) /* address */, packet->peripheral_type);
+    write_uint16(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint8_t) /* address */ + sizeof(uint32_t) /* peripheral type */, packet->peripheral_version);
+}
+aus1_announce_packet aus1_decode_announce(uint8_t *buf) {
+    aus1_announce_packet packet = {0};
+    if (buf[0] != AUS1_TYPE_ANNOUNCE_FIELD) return packet;
+
+    packet.address = buf[sizeof(uint8_t) /* packet type */];
+    packet.peripheral_type = read_uint32(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint8_t) /* address */);
+    packet.peripheral_version = read_uint16(buf + sizeof(uint8_t) /* packet type */ + sizeof(uint8_t) /* address */ + sizeof(uint32_t) /* peripheral type */);
 
     return packet;
 }
 
+void aus1_encode_heartbeat(uint8_t *buf, uint8_t address) {
+    buf[0] = AUS1_TYPE_HEARTBEAT_FIELD;
+    buf[1] = address;
+}
+uint8_t aus1_decode_heartbeat(uint8_t *buf) {
+    if (buf[0] != AUS1_TYPE_HEARTBEAT_FIELD) return 0;
+    return buf[sizeof(uint8_t) /* packet type */];
+}
+
+uint8_t aus1_discovery_reply_size(const uint8_t *buf) {
+    switch (buf[0]) {
+        case AUS1_TYPE_ANNOUNCE_FIELD:  return AUS1_ANNOUNCE_PACKET_SIZE;
+        case AUS1_TYPE_HEARTBEAT_FIELD: return AUS1_HEARTBEAT_PACKET_SIZE;
+        default:                        return 0;
+    }
+}
+
+uint8_t aus1_chunk_data_size(uint8_t capabilities) {
+    return (capabilities & AUS1_CAPABILITY_FEC) ? AUS1_FEC_CHUNK_DATA_SIZE : AUS1_DATA_PACKET_SIZE;
+}
+
+// Hamming positions of the 56 data bits in a codeword: every position in 1..62 that is not a power of two.
+// The syndrome of a single flipped bit is its position, so positions must be unique and non-zero.
+static const uint8_t fec_bit_positions[AUS1_FEC_CODEWORD_DATA_SIZE * 8] = {
+     3,  5,  6,  7,  9, 10, 11, 12, 13, 14, 15, 17, 18, 19, 20, 21,
+    22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 33, 34, 35, 36, 37, 38,
+    39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54,
+    55, 56, 57, 58, 59, 60, 61, 62
+};
+
+#define FEC_SYNDROME_MASK 0x3F
+#define FEC_PARITY_BIT    0x40
+
+/**
+ * @brief Provides the parity of a byte
+ */
+static uint8_t fec_parity(uint8_t val) {
+    val ^= val >> 4;
+    val ^= val >> 2;
+    val ^= val >> 1;
+    return val & 1;
+}
+
+/**
+ * @brief Provides the Hamming syndrome and parity of a codeword's data bits
+ * 
+ * @param data The `AUS1_FEC_CODEWORD_DATA_SIZE` data bytes
+ * @param parity Set to the parity of the data bits
+ * @return The XOR of the positions of every set bit
+ */
+static uint8_t fec_syndrome(const uint8_t *data, uint8_t *parity) {
+    uint8_t syndrome = 0;
+    uint8_t p = 0;
+
+    for (uint8_t i = 0; i < AUS1_FEC_CODEWORD_DATA_SIZE; i++) {
+        uint8_t byte = data[i];
+        p ^= byte;
+
+        const uint8_t *positions = fec_bit_positions + i * 8;
+        for (uint8_t bit = 0; byte; bit++, byte >>= 1) {
+            if (byte & 1) syndrome ^= positions[bit];
+        }
+    }
+
+    *parity = fec_parity(p);
+    return syndrome;
+}
+
+void aus1_fec_encode_chunk(uint8_t *chunk, const uint8_t *data) {
+    for (uint8_t i = 0; i < AUS1_DATA_PACKET_SIZE / AUS1_FEC_CODEWORD_SIZE; i++) {
+        const uint8_t *in = data + i * AUS1_FEC_CODEWORD_DATA_SIZE;
+        uint8_t *out = chunk + i * AUS1_FEC_CODEWORD_SIZE;
+
+        uint8_t parity;
+        uint8_t syndrome = fec_syndrome(in, &parity);
+
+        memmove(out, in, AUS1_FEC_CODEWORD_DATA_SIZE);
+        // The parity bit makes the whole codeword even, which tells single errors apart from double ones
+        out[AUS1_FEC_CODEWORD_DATA_SIZE] = syndrome | ((parity ^ fec_parity(syndrome)) ? FEC_PARITY_BIT : 0);
+    }
+}
+
+int aus1_fec_decode_chunk(uint8_t *data, const uint8_t *chunk) {
+    int corrected = 0;
+
+    for (uint8_t i = 0; i < AUS1_DATA_PACKET_SIZE / AUS1_FEC_CODEWORD_SIZE; i++) {
+        uint8_t codeword[AUS1_FEC_CODEWORD_SIZE];
+        memcpy(codeword, chunk + i * AUS1_FEC_CODEWORD_SIZE, AUS1_FEC_CODEWORD_SIZE);
+
+        uint8_t check = codeword[AUS1_FEC_CODEWORD_DATA_SIZE] & (FEC_SYNDROME_MASK | FEC_PARITY_BIT);
+
+        uint8_t parity;
+        uint8_t syndrome = fec_syndrome(codeword, &parity) ^ (check & FEC_SYNDROME_MASK);
+        parity ^= fec_parity(check);
+
+        if (parity) { // odd number of flipped bits; assume one
+            if (syndrome & (syndrome - 1)) { // not a power of two, so a data bit flipped
+                uint8_t bit = 0;
+                while (bit < AUS1_FEC_CODEWORD_DATA_SIZE * 8 && fec_bit_positions[bit] != syndrome) bit++;
+                if (bit == AUS1_FEC_CODEWORD_DATA_SIZE * 8) return -1; // position 63 holds no data
+
+                codeword[bit / 8] ^= (uint8_t) (1 << (bit % 8));
+            }
+            // otherwise the flipped bit was a check bit and the data is intact
+            corrected++;
+        } else if (syndrome) { // even number of flipped bits
+            return -1;
+        }
+
+        memcpy(data + i * AUS1_FEC_CODEWORD_DATA_SIZE, codeword, AUS1_FEC_CODEWORD_DATA_SIZE);
+    }
+
+    return corrected;
+}
+
 /**
  * @brief Writes a 16-bit unsigned host int into a network buffer
  * @note Requires the buffer to be at least 2 bytes in size
@@ -99,7 +329,7 @@ void write_uint16_raw(uint8_t* buf, uint16_t val) {
  * @param val The value to write into the buffer
  */
 void write_uint32(uint8_t *buf, uint32_t val) {
-    write_uint16_raw(buf, htonl(val));
+    write_uint32_raw(buf, htonl(val));
 }
 
 /**
@@ -20,43 +20,98 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define CRC_HASH_SIZE 4
 
 #define AUS1_I2C_ADDRESS 0x0A
+// Reaches every peripheral that listens for the I2C general call
+#define AUS1_GENERAL_CALL_ADDRESS 0x00
 
 // Utility macros for allocating packets
-#define AUS1_PING_PACKET_SIZE            1
-#define AUS1_PING_RESPONSE_PACKET_SIZE   7
-#define AUS1_START_OF_STREAM_PACKET_SIZE 7
+#define AUS1_PING_PACKET_SIZE            3
+#define AUS1_PING_RESPONSE_PACKET_SIZE   9
+#define AUS1_STREAM_REQUEST_PACKET_SIZE  1
+#define AUS1_START_OF_STREAM_PACKET_SIZE 7 // largest size; see aus1_start_of_stream_size()
 
-#define AUS1_DATA_REQUEST_SIZE 7
+#define AUS1_DISCOVER_PACKET_SIZE        3
+#define AUS1_ANNOUNCE_PACKET_SIZE        8
+#define AUS1_HEARTBEAT_PACKET_SIZE       2
 
 #define AUS1_DATA_PACKET_SIZE 32
 
+// Optional features, negotiated through PING and PING-RESPONSE
+#define AUS1_CAPABILITY_FEC 0x01 // data chunks carry SECDED parity
+
+// Times a peripheral tries to answer a DISCOVER packet, doubling its slot window after each collision
+#define AUS1_DISCOVERY_ATTEMPTS 3
+
+// How peripherals should answer a DISCOVER packet
+#define AUS1_DISCOVER_MODE_ANNOUNCE  0 // with an ANNOUNCE describing themselves
+#define AUS1_DISCOVER_MODE_HEARTBEAT 1 // with a HEARTBEAT, to show they are still there
+
+// Integrity checks for data, negotiated through PING and PING-RESPONSE
+#define AUS1_INTEGRITY_CRC32       0 // 4 bytes; the default, and always supported
+#define AUS1_INTEGRITY_CRC16_CCITT 1 // 2 bytes
+#define AUS1_INTEGRITY_CRC8        2 // 1 byte
+#define AUS1_INTEGRITY_FLETCHER16  3 // 2 bytes, cheapest on 8-bit parts
+
+// FEC splits each data chunk into SECDED codewords of 7 data bytes and 1 check byte
+#define AUS1_FEC_CODEWORD_DATA_SIZE 7
+#define AUS1_FEC_CODEWORD_SIZE      8
+#define AUS1_FEC_CHUNK_DATA_SIZE    ((AUS1_DATA_PACKET_SIZE / AUS1_FEC_CODEWORD_SIZE) * AUS1_FEC_CODEWORD_DATA_SIZE)
+
+// Returned by update() when only a wake event can make further progress
+#define AUS1_NO_DEADLINE ((unsigned long) -1)
+
+// Events that should wake a sleeping application (see wake_events())
+#define AUS1_WAKE_DEADLINE 0x01 // the delay returned by update() has passed
+#define AUS1_WAKE_BUS      0x02 // the I2C peripheral interrupt fired
+
+typedef struct {
+    uint8_t capabilities;
+    uint8_t integrity;
+} aus1_ping_packet;
+
 typedef struct {
     uint32_t peripheral_type;
     uint16_t peripheral_version;
+    uint8_t capabilities;
+    uint8_t integrity;
 } aus1_ping_response_packet;
 
 typedef struct {
     uint16_t data_size;
-    uint32_t crc_hash;
+    uint32_t check_value;
+    uint8_t integrity; // not sent; selects the size of `check_value` on the wire
 } aus1_start_of_stream_packet;
 
+typedef struct {
+    uint8_t mode;
+    uint8_t window_ms;
+} aus1_discover_packet;
+
+typedef struct {
+    uint8_t address;
+    uint32_t peripheral_type;
+    uint16_t peripheral_version;
+} aus1_announce_packet;
+
 /**
  * @brief Writes an AUS1 PING packet into a buffer
  * 
  * @param buf The buffer to write into
+ * @param packet The packet to write into the buffer
  */
-void aus1_encode_ping(uint8_t *buf);
+void aus1_encode_ping(uint8_t *buf, const aus1_ping_packet *packet);
 /**
  * @brief Decodes an AUS1 PING packet from a buffer
  * 
  * @param buf 
+ * @param packet The packet to decode into
  * @return Whether the packet was a ping packet
  */
-bool aus1_decode_ping(uint8_t *buf);
+bool aus1_decode_ping(uint8_t *buf, aus1_ping_packet *packet);
 
 /**
  * @brief Writes an AUS1 PING RESPONSE packet into a buffer
@@ -74,6 +129,20 @@ void aus1_encode_ping_response(uint8_t *buf, const aus1_ping_response_packet *pa
  */
 aus1_ping_response_packet aus1_decode_ping_response(uint8_t *buf);
 
+/**
+ * @brief Writes an AUS1 STREAM-REQUEST packet into a buffer
+ * 
+ * @param buf The buffer to write into
+ */
+void aus1_encode_stream_request(uint8_t *buf);
+/**
+ * @brief Decodes an AUS1 STREAM-REQUEST packet from a buffer
+ * 
+ * @param buf 
+ * @return Whether the packet was a stream request packet
+ */
+bool aus1_decode_stream_request(uint8_t *buf);
+
 /**
  * @brief Writes an AUS1 START-OF-STREAM packet into a buffer
  * 
@@ -85,7 +154,141 @@ void aus1_encode_start_of_stream(uint8_t *buf, const aus1_start_of_stream_packet
  * @brief Decodes an AUS1 START-OF-STREAM packet from a buffer
  * 
  * @param buf 
+ * @param integrity The negotiated `AUS1_INTEGRITY_*` check
+ * @return The decoded packet
+ * @return {0} If the packet was invalid
+ */
+aus1_start_of_stream_packet aus1_decode_start_of_stream(uint8_t *buf, uint8_t integrity);
+/**
+ * @brief Provides the size of a START-OF-STREAM packet
+ * 
+ * @param integrity The negotiated `AUS1_INTEGRITY_*` check
+ * @return The packet size in bytes
+ */
+uint8_t aus1_start_of_stream_size(uint8_t integrity);
+
+/**
+ * @brief Provides the size of an integrity check value on the wire
+ * 
+ * @param integrity An `AUS1_INTEGRITY_*` check
+ * @return The size in bytes
+ * @return 0 If the check is unknown
+ */
+uint8_t aus1_integrity_size(uint8_t integrity);
+/**
+ * @brief Starts a running integrity check
+ * 
+ * @param integrity An `AUS1_INTEGRITY_*` check
+ * @return The initial running state
+ */
+uint32_t aus1_integrity_init(uint8_t integrity);
+/**
+ * @brief Folds a buffer into a running integrity check
+ * 
+ * @param integrity An `AUS1_INTEGRITY_*` check
+ * @param state The running state
+ * @param buf The buffer to check
+ * @param len The length of the buffer
+ * @return The updated running state
+ */
+uint32_t aus1_integrity_update(uint8_t integrity, uint32_t state, const uint8_t *buf, size_t len);
+/**
+ * @brief Finishes a running integrity check
+ * 
+ * @param integrity An `AUS1_INTEGRITY_*` check
+ * @param state The running state
+ * @return The check value, as carried by START-OF-STREAM
+ */
+uint32_t aus1_integrity_final(uint8_t integrity, uint32_t state);
+/**
+ * @brief Computes the integrity check value of a buffer
+ * 
+ * @param integrity An `AUS1_INTEGRITY_*` check
+ * @param buf The buffer to check
+ * @param len The length of the buffer
+ * @return The check value, as carried by START-OF-STREAM
+ */
+uint32_t aus1_integrity_compute(uint8_t integrity, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Writes an AUS1 DISCOVER packet into a buffer
+ * 
+ * @param buf The buffer to write into
+ * @param packet The packet to write into the buffer
+ */
+void aus1_encode_discover(uint8_t *buf, const aus1_discover_packet *packet);
+/**
+ * @brief Decodes an AUS1 DISCOVER packet from a buffer
+ * 
+ * @param buf 
+ * @param packet The packet to decode into
+ * @return Whether the packet was a discover packet
+ */
+bool aus1_decode_discover(uint8_t *buf, aus1_discover_packet *packet);
+
+/**
+ * @brief Writes an AUS1 ANNOUNCE packet into a buffer
+ * 
+ * @param buf The buffer to write into
+ * @param packet The packet to write into the buffer
+ */
+void aus1_encode_announce(uint8_t *buf, const aus1_announce_packet *packet);
+/**
+ * @brief Decodes an AUS1 ANNOUNCE packet from a buffer
+ * 
+ * @param buf 
  * @return The decoded packet
  * @return {0} If the packet was invalid
  */
-aus1_start_of_stream_packet aus1_decode_start_of_stream(uint8_t *buf);
+aus1_announce_packet aus1_decode_announce(uint8_t *buf);
+
+/**
+ * @brief Writes an AUS1 HEARTBEAT packet into a buffer
+ * 
+ * @param buf The buffer to write into
+ * @param address The address of the peripheral sending it
+ */
+void aus1_encode_heartbeat(uint8_t *buf, uint8_t address);
+/**
+ * @brief Decodes an AUS1 HEARTBEAT packet from a buffer
+ * 
+ * @param buf 
+ * @return The address of the peripheral that sent it
+ * @return 0 If the packet was invalid
+ */
+uint8_t aus1_decode_heartbeat(uint8_t *buf);
+
+/**
+ * @brief Provides the size of a packet peripherals send in reply to DISCOVER
+ * 
+ * @param buf A buffer starting with the packet type
+ * @return The size of the ANNOUNCE or HEARTBEAT packet
+ * @return 0 If the packet is neither
+ */
+uint8_t aus1_discovery_reply_size(const uint8_t *buf);
+
+/**
+ * @brief Provides the number of payload bytes carried by each data chunk
+ * 
+ * @param capabilities The negotiated capabilities
+ * @return The payload bytes per chunk
+ */
+uint8_t aus1_chunk_data_size(uint8_t capabilities);
+
+/**
+ * @brief Encodes a chunk of payload into SECDED codewords
+ * 
+ * @param chunk The buffer to write the `AUS1_DATA_PACKET_SIZE` byte chunk into
+ * @param data The `AUS1_FEC_CHUNK_DATA_SIZE` bytes of payload to encode
+ */
+void aus1_fec_encode_chunk(uint8_t *chunk, const uint8_t *data);
+/**
+ * @brief Corrects and decodes a chunk of SECDED codewords
+ * @note `data` may point to `chunk` or before it; each codeword is read before its payload is written
+ * 
+ * @param data The buffer to write the `AUS1_FEC_CHUNK_DATA_SIZE` bytes of payload into
+ * @param chunk The `AUS1_DATA_PACKET_SIZE` byte chunk
+ * @return The number of bits corrected
+ * @return -1 If a codeword had more errors than can be corrected
+ */
+int aus1_fec_decode_chunk(uint8_t *data, const uint8_t *chunk);
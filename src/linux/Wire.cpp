@@ -0,0 +1,179 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "Wire.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+
+static std::atomic<bool> manual_clock(false);
+static std::atomic<unsigned long> manual_clock_us(0);
+
+static unsigned long steady_us() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return (unsigned long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::minstd_rand &random_engine() {
+    thread_local std::minstd_rand engine;
+    return engine;
+}
+
+/**
+ * @brief The wire whose request callback is running on this thread, if any
+ */
+thread_local static TwoWire *answering_wire = nullptr;
+
+/**
+ * @brief Held while a callback runs, standing in for AVR's global interrupt flag
+ */
+static std::recursive_mutex &interrupt_lock() {
+    static std::recursive_mutex lock;
+    return lock;
+}
+
+unsigned long millis() { return micros() / 1000; }
+
+unsigned long micros() { return manual_clock.load(std::memory_order_relaxed) ? manual_clock_us.load(std::memory_order_relaxed) : steady_us(); }
+
+long random(long max) { return max <= 0 ? 0 : (long) (random_engine()() % (unsigned long) max); }
+
+long random(long min, long max) { return max <= min ? min : min + random(max - min); }
+
+void randomSeed(unsigned long seed) { random_engine().seed((std::minstd_rand::result_type) seed); }
+
+void noInterrupts() { interrupt_lock().lock(); }
+
+void interrupts() { interrupt_lock().unlock(); }
+
+namespace superi2c {
+    void host_clock_set_manual(bool manual) {
+        if (manual) manual_clock_us.store(steady_us()); // carry on from the current time, so elapsed times stay small
+        manual_clock.store(manual);
+    }
+
+    void host_clock_advance(unsigned long us) { manual_clock_us.fetch_add(us); }
+}
+
+TwoWire::TwoWire(superi2c::i2c_transport *transport)
+    : transport(transport),
+      tx_address(0),
+      general_call(false),
+      receive_handler(nullptr),
+      request_handler(nullptr) {}
+
+TwoWire::~TwoWire() { end(); }
+
+void TwoWire::begin() {}
+
+void TwoWire::begin(uint8_t address) { transport->attach(address, this); }
+
+void TwoWire::end() { transport->detach(this); }
+
+void TwoWire::setClock(uint32_t rate) { transport->set_clock(rate); }
+
+void TwoWire::beginTransmission(uint8_t address) {
+    tx_address = address;
+    tx.clear();
+}
+
+uint8_t TwoWire::endTransmission(bool /* stop */) {
+    if (tx.size() > WIRE_BUFFER_LENGTH) return WIRE_STATUS_TOO_LONG;
+    return transport->transmit(tx_address, tx.data(), tx.size());
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity) {
+    if (quantity > WIRE_BUFFER_LENGTH) quantity = WIRE_BUFFER_LENGTH;
+    if (quantity <= 0) return 0;
+
+    // As on Arduino, a read replaces whatever was left unread
+    uint8_t buf[WIRE_BUFFER_LENGTH];
+    size_t count = transport->receive((uint8_t) address, buf, (size_t) quantity);
+
+    std::lock_guard<std::mutex> lock(rx_mutex);
+    rx.assign(buf, buf + count);
+    return (uint8_t) count;
+}
+
+size_t TwoWire::write(uint8_t byte) { return write(&byte, 1); }
+
+size_t TwoWire::write(const uint8_t *buf, size_t len) {
+    std::vector<uint8_t> &out = answering_wire == this ? answer : tx;
+    if (out.size() + len > WIRE_BUFFER_LENGTH) len = WIRE_BUFFER_LENGTH - out.size(); // Arduino's buffers are fixed
+    out.insert(out.end(), buf, buf + len);
+    return len;
+}
+
+int TwoWire::available() {
+    std::lock_guard<std::mutex> lock(rx_mutex);
+    return (int) rx.size();
+}
+
+int TwoWire::read() {
+    std::lock_guard<std::mutex> lock(rx_mutex);
+    if (rx.empty()) return -1;
+
+    uint8_t byte = rx.front();
+    rx.pop_front();
+    return byte;
+}
+
+int TwoWire::peek() {
+    std::lock_guard<std::mutex> lock(rx_mutex);
+    return rx.empty() ? -1 : rx.front();
+}
+
+void TwoWire::onReceive(void (*handler)(int)) { receive_handler = handler; }
+
+void TwoWire::onRequest(void (*handler)(void)) { request_handler = handler; }
+
+void TwoWire::enableGeneralCall(bool enabled) { general_call = enabled; }
+
+bool TwoWire::generalCallEnabled() const { return general_call; }
+
+void TwoWire::deliver_write(const uint8_t *buf, size_t len) {
+    std::lock_guard<std::recursive_mutex> in_interrupt(interrupt_lock());
+
+    // As on AVR, the write is dropped if nobody would read it, or if it would overwrite unread bytes
+    if (!receive_handler) return;
+    {
+        std::lock_guard<std::mutex> lock(rx_mutex);
+        if (!rx.empty()) return;
+        rx.assign(buf, buf + len);
+    }
+
+    // Not held across the callback, which reads the bytes back
+    receive_handler((int) len);
+}
+
+size_t TwoWire::answer_read(uint8_t *buf, size_t len) {
+    std::lock_guard<std::recursive_mutex> in_interrupt(interrupt_lock());
+    answer.clear();
+
+    TwoWire *outer = answering_wire;
+    answering_wire = this;
+    if (request_handler) request_handler();
+    answering_wire = outer;
+
+    size_t count = answer.size() < len ? answer.size() : len;
+    std::copy(answer.begin(), answer.begin() + count, buf);
+    return count;
+}
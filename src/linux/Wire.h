@@ -0,0 +1,223 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+// Host-side (Linux) stand-in for Arduino's Wire library, so AUS1 controllers and peripherals build on the host.
+// Each `TwoWire` talks through an `i2c_transport`: a /dev/i2c-N adapter (i2c_dev.h) or an in-memory bus (i2c_loopback.h).
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// endTransmission() statuses, as returned by Arduino's Wire
+#define WIRE_STATUS_OK           0
+#define WIRE_STATUS_TOO_LONG     1
+#define WIRE_STATUS_ADDRESS_NACK 2
+#define WIRE_STATUS_DATA_NACK    3
+#define WIRE_STATUS_OTHER        4
+#define WIRE_STATUS_TIMEOUT      5
+
+// Largest transfer in either direction, matching Arduino's Wire buffers
+#define WIRE_BUFFER_LENGTH 32
+
+/**
+ * @brief Gets the number of milliseconds since the program started, or the manual clock's time
+ */
+unsigned long millis();
+/**
+ * @brief Gets the number of microseconds since the program started, or the manual clock's time
+ */
+unsigned long micros();
+/**
+ * @brief Gets a pseudo-random number in [0, max)
+ */
+long random(long max);
+/**
+ * @brief Gets a pseudo-random number in [min, max)
+ */
+long random(long min, long max);
+/**
+ * @brief Seeds `random()` for the calling thread
+ */
+void randomSeed(unsigned long seed);
+/**
+ * @brief Holds off receive and request callbacks until `interrupts()`, as disabling interrupts does on AVR
+ * @note Callbacks run on whichever thread drives the transfer, so this is a lock; pair it on the same thread
+ */
+void noInterrupts();
+/**
+ * @brief Lets receive and request callbacks run again after `noInterrupts()`
+ */
+void interrupts();
+
+class TwoWire;
+
+namespace superi2c {
+    /**
+     * @brief Makes `millis()` and `micros()` follow a clock that only moves when told to, for tests and simulations
+     *
+     * @param manual Whether to use the manual clock
+     */
+    void host_clock_set_manual(bool manual);
+    /**
+     * @brief Moves the manual clock forward
+     *
+     * @param us The number of microseconds to advance by
+     */
+    void host_clock_advance(unsigned long us);
+
+    /**
+     * @brief Carries I2C transfers for a `TwoWire`
+     */
+    class i2c_transport {
+    public:
+        virtual ~i2c_transport() = default;
+
+        /**
+         * @brief Writes bytes to a target
+         *
+         * @param address The 7-bit target address
+         * @param buf The bytes to write
+         * @param len The number of bytes
+         * @return A `WIRE_STATUS_*` status
+         */
+        virtual uint8_t transmit(uint8_t address, const uint8_t *buf, size_t len) = 0;
+        /**
+         * @brief Reads bytes from a target
+         *
+         * @param address The 7-bit target address
+         * @param buf The buffer to read into
+         * @param len The number of bytes to read
+         * @return The number of bytes read, 0 if the target did not acknowledge
+         */
+        virtual size_t receive(uint8_t address, uint8_t *buf, size_t len) = 0;
+        /**
+         * @brief Changes the bus clock rate, where the transport can
+         *
+         * @param rate The rate in Hz
+         */
+        virtual void set_clock(uint32_t rate) { (void) rate; }
+        /**
+         * @brief Registers a wire that answers transfers addressed to it
+         *
+         * @param address The 7-bit address the wire answers on
+         * @param wire The wire
+         * @return Whether the transport can act as a target
+         */
+        virtual bool attach(uint8_t address, TwoWire *wire) { (void) address; (void) wire; return false; }
+        /**
+         * @brief Stops a wire from answering transfers
+         */
+        virtual void detach(TwoWire *wire) { (void) wire; }
+    };
+}
+
+/**
+ * @brief The subset of Arduino's `TwoWire` used by AUS1, over an `i2c_transport`
+ *
+ * As a controller, transfers block until done, as on Arduino. As a target (`begin(address)`), behaves as AVR's Wire:
+ * a write addressed to the wire is handed to the receive callback, which must read it there, and is dropped if no
+ * callback is registered or bytes from an earlier transfer are still unread. Reads are answered by the request
+ * callback through `write()`. Both callbacks run as if in the TWI interrupt (see `noInterrupts()`).
+ */
+class TwoWire {
+public:
+    /**
+     * @brief Construct a new wire over a transport
+     *
+     * @param transport The transport. Must outlive the wire.
+     */
+    explicit TwoWire(superi2c::i2c_transport *transport);
+    ~TwoWire();
+
+    TwoWire(const TwoWire &) = delete;
+    TwoWire &operator=(const TwoWire &) = delete;
+
+    void begin();
+    void begin(uint8_t address);
+    void end();
+    void setClock(uint32_t rate);
+
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool stop = true);
+    uint8_t requestFrom(int address, int quantity);
+
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t *buf, size_t len);
+    int available();
+    int read();
+    int peek();
+
+    void onReceive(void (*handler)(int));
+    void onRequest(void (*handler)(void));
+
+    /**
+     * @brief Lets the wire receive writes to the general call address `0x00`, as a target
+     * @note Host-only; on AVR this is bit 0 of `TWAR`
+     *
+     * @param enabled Whether to answer the general call
+     */
+    void enableGeneralCall(bool enabled);
+    /**
+     * @brief Whether the wire receives writes to the general call address
+     */
+    bool generalCallEnabled() const;
+
+    /**
+     * @brief Delivers a write addressed to this wire. Called by transports.
+     *
+     * @param buf The bytes written
+     * @param len The number of bytes
+     */
+    void deliver_write(const uint8_t *buf, size_t len);
+    /**
+     * @brief Answers a read addressed to this wire through the request callback. Called by transports.
+     *
+     * @param buf The buffer to answer into
+     * @param len The number of bytes asked for
+     * @return The number of bytes the request callback wrote
+     */
+    size_t answer_read(uint8_t *buf, size_t len);
+
+private:
+    superi2c::i2c_transport *transport;
+
+    /**
+     * @brief Bytes read as a controller, or written to this wire as a target, waiting for `read()`
+     * @note Guarded by `rx_mutex`, as targets are written to from whichever thread drives the bus.
+     *       One buffer serves both, as on AVR.
+     */
+    std::deque<uint8_t> rx;
+    std::mutex rx_mutex;
+    /**
+     * @brief Bytes queued by `write()` for the current transmission
+     */
+    std::vector<uint8_t> tx;
+    uint8_t tx_address;
+    /**
+     * @brief Bytes queued by `write()` from inside the request callback
+     */
+    std::vector<uint8_t> answer;
+    bool general_call;
+
+    void (*receive_handler)(int);
+    void (*request_handler)(void);
+};
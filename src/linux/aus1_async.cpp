@@ -0,0 +1,288 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "aus1_async.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace superi2c {
+    aus1_async_controller::fetch_awaitable::fetch_awaitable(aus1_async_controller *owner,
+                                                            uint8_t address,
+                                                            std::chrono::milliseconds timeout,
+                                                            std::stop_token stop)
+        : owner(owner),
+          fetch{ nullptr, address, std::chrono::steady_clock::now() + timeout, std::move(stop),
+                 { aus1_fetch_status::CANCELLED, {} } } {}
+
+    void aus1_async_controller::fetch_awaitable::await_suspend(std::coroutine_handle<> handle) {
+        fetch.handle = handle;
+        owner->enqueue(&fetch);
+    }
+
+    aus1_fetch_result aus1_async_controller::fetch_awaitable::await_resume() { return std::move(fetch.result); }
+
+    aus1_async_controller::aus1_async_controller(aus1_event_loop *loop, TwoWire *wire)
+        : loop(loop),
+          inner(wire),
+          front_requested(false) {
+        loop->activate(this);
+    }
+
+    aus1_async_controller::~aus1_async_controller() {
+        if (front_requested) inner.cancel_request();
+
+        while (!queue.empty()) {
+            finish(queue.front(), aus1_fetch_status::CANCELLED);
+        }
+
+        loop->detach(this);
+    }
+
+    aus1_async_controller::fetch_awaitable aus1_async_controller::fetch(uint8_t address,
+                                                                       std::chrono::milliseconds timeout,
+                                                                       std::stop_token stop) {
+        return fetch_awaitable(this, address, timeout, std::move(stop));
+    }
+
+    aus1_controller &aus1_async_controller::controller() { return inner; }
+
+    void aus1_async_controller::enqueue(pending_fetch *fetch) {
+        queue.push_back(fetch);
+        loop->activate(this);
+    }
+
+    std::chrono::steady_clock::time_point aus1_async_controller::tick(std::chrono::steady_clock::time_point now,
+                                                                      std::chrono::microseconds poll_interval) {
+        // Expire fetches first so a cancelled front fetch frees the controller for the next one
+        for (size_t i = 0; i < queue.size();) {
+            pending_fetch *fetch = queue[i];
+
+            aus1_fetch_status status;
+            if (fetch->stop.stop_requested()) {
+                status = aus1_fetch_status::CANCELLED;
+            } else if (now >= fetch->deadline) {
+                status = aus1_fetch_status::TIMED_OUT;
+            } else {
+                i++;
+                continue;
+            }
+
+            if (i == 0 && front_requested) {
+                inner.cancel_request();
+                front_requested = false;
+            }
+            finish(fetch, status); // removes queue[i]
+        }
+
+        // As in the gateway, only request once the PINGs sent by update() have connected the fetch's peripheral
+        if (!queue.empty() && !front_requested && inner.get_state() == aus1_controller_state::IDLE) {
+            inner.set_peripheral_address(queue.front()->address);
+            if (inner.connected()) {
+                inner.request_data(&aus1_async_controller::receive, this);
+                front_requested = true;
+            }
+        }
+
+        unsigned long delay = inner.update();
+
+        // Invalid replies make the controller drop its receiver without calling it, and a peripheral that stops
+        // answering disconnects it; fail fast instead of timing out
+        if (front_requested && (!inner.has_receiver() || !inner.connected())) {
+            inner.cancel_request();
+            front_requested = false;
+            finish(queue.front(), aus1_fetch_status::DISCONNECTED);
+        }
+
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+        if (delay != AUS1_NO_DEADLINE) next = now + std::chrono::milliseconds(delay);
+        if (!queue.empty() && !front_requested && inner.connected()) next = now; // request the next fetch promptly
+        if (inner.wake_events() & AUS1_WAKE_BUS) next = std::min(next, now + poll_interval);
+        for (pending_fetch *fetch : queue) {
+            next = std::min(next, fetch->deadline);
+        }
+
+        return next;
+    }
+
+    void aus1_async_controller::finish(pending_fetch *fetch, aus1_fetch_status status) {
+        fetch->result.status = status;
+        queue.erase(std::find(queue.begin(), queue.end(), fetch));
+        loop->ready.push_back(fetch->handle);
+    }
+
+    void aus1_async_controller::receive(void *context, uint8_t *buf, size_t data_size, size_t /* buf_size */) {
+        aus1_async_controller *self = (aus1_async_controller *) context;
+        self->front_requested = false;
+        if (self->queue.empty()) return;
+
+        pending_fetch *fetch = self->queue.front();
+        if (buf) {
+            fetch->result.data.assign(buf, buf + data_size);
+            self->finish(fetch, aus1_fetch_status::OK);
+        } else {
+            self->finish(fetch, aus1_fetch_status::CHECKSUM_FAILED);
+        }
+    }
+
+    aus1_event_loop::aus1_event_loop()
+        : epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+          timer_fd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)),
+          wake_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          tick_interval(AUS1_ASYNC_DEFAULT_TICK_US),
+          timer_deadline(std::chrono::steady_clock::time_point::max()),
+          stopping(false) {
+        if (!valid()) return;
+
+        epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+
+        event.data.fd = timer_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event);
+        event.data.fd = wake_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+    }
+
+    aus1_event_loop::~aus1_event_loop() {
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (timer_fd >= 0) close(timer_fd);
+        if (wake_fd >= 0) close(wake_fd);
+    }
+
+    bool aus1_event_loop::valid() const { return epoll_fd >= 0 && timer_fd >= 0 && wake_fd >= 0; }
+
+    int aus1_event_loop::fd() const { return epoll_fd; }
+
+    void aus1_event_loop::set_tick_interval(unsigned long interval) { this->tick_interval = interval; }
+
+    bool aus1_event_loop::run_once(int timeout_ms) {
+        if (!valid()) return false;
+
+        // Resume coroutines that finished outside of a tick (e.g. a controller was destroyed)
+        if (!ready.empty()) timeout_ms = 0;
+
+        epoll_event events[2];
+        int count = epoll_wait(epoll_fd, events, 2, timeout_ms);
+        if (count < 0) return errno == EINTR;
+
+        uint64_t expirations;
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.fd == timer_fd) {
+                while (read(timer_fd, &expirations, sizeof(expirations)) > 0) {}
+                timer_deadline = std::chrono::steady_clock::time_point::max(); // one-shot
+            } else if (events[i].data.fd == wake_fd) {
+                while (read(wake_fd, &expirations, sizeof(expirations)) > 0) {}
+            }
+        }
+
+        tick();
+
+        return !stopping.load();
+    }
+
+    void aus1_event_loop::run() {
+        stopping.store(false);
+        while (run_once(-1)) {}
+    }
+
+    void aus1_event_loop::stop() {
+        stopping.store(true);
+
+        uint64_t one = 1;
+        (void) !write(wake_fd, &one, sizeof(one));
+    }
+
+    void aus1_event_loop::activate(aus1_async_controller *controller) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        bool found = false;
+        for (active_controller &entry : active) {
+            if (entry.controller == controller) {
+                entry.deadline = now; // tick it promptly so the new fetch is requested
+                found = true;
+            }
+        }
+        if (!found) active.push_back({ controller, now });
+
+        arm_timer(now);
+    }
+
+    void aus1_event_loop::detach(aus1_async_controller *controller) {
+        active.erase(std::remove_if(active.begin(), active.end(), [controller](const active_controller &entry) {
+            return entry.controller == controller;
+        }), active.end());
+
+        // Make sure the cancelled coroutines get resumed
+        if (!ready.empty()) {
+            uint64_t one = 1;
+            (void) !write(wake_fd, &one, sizeof(one));
+        }
+    }
+
+    void aus1_event_loop::tick() {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::microseconds poll_interval(tick_interval);
+
+        // Only finish() runs inside controller ticks, so `active` is stable while iterating
+        for (active_controller &entry : active) {
+            if (entry.deadline > now) continue;
+
+            // Never schedule sooner than the tick interval so a controller that is always due cannot spin the loop
+            entry.deadline = std::max(entry.controller->tick(now, poll_interval), now + poll_interval);
+        }
+
+        // Resume outside of controller updates so resumed coroutines can safely fetch again
+        while (!ready.empty()) {
+            std::vector<std::coroutine_handle<>> resuming;
+            resuming.swap(ready);
+            for (std::coroutine_handle<> handle : resuming) {
+                handle.resume();
+            }
+        }
+
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::time_point::max();
+        for (const active_controller &entry : active) {
+            next = std::min(next, entry.deadline);
+        }
+        arm_timer(next);
+    }
+
+    void aus1_event_loop::arm_timer(std::chrono::steady_clock::time_point deadline) {
+        if (deadline == timer_deadline) return;
+
+        itimerspec spec;
+        memset(&spec, 0, sizeof(spec));
+        if (deadline != std::chrono::steady_clock::time_point::max()) {
+            long long delay_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if (delay_ns < 1) delay_ns = 1; // zero would disarm
+
+            spec.it_value.tv_sec = delay_ns / 1000000000;
+            spec.it_value.tv_nsec = delay_ns % 1000000000;
+        }
+
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+        timer_deadline = deadline;
+    }
+}
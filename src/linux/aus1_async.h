@@ -0,0 +1,297 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+// Host-side (Linux) C++20 coroutine API. Like the gateway, builds against the `Wire.h` in this directory.
+
+#include "../arduino/aus1_controller.h"
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <stop_token>
+#include <vector>
+
+// Default shortest time between controller updates, also used to poll for bus replies
+#define AUS1_ASYNC_DEFAULT_TICK_US 1000
+// Default time before a fetch gives up
+#define AUS1_ASYNC_DEFAULT_TIMEOUT_MS 500
+
+namespace superi2c {
+    class aus1_event_loop;
+
+    /**
+     * @brief Defines how a fetch finished
+     */
+    enum class aus1_fetch_status {
+        OK,
+        CHECKSUM_FAILED,
+        DISCONNECTED, // the peripheral sent an invalid reply
+        TIMED_OUT,
+        CANCELLED
+    };
+
+    /**
+     * @brief The outcome of a fetch
+     */
+    struct aus1_fetch_result {
+        aus1_fetch_status status;
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * @brief A fire-and-forget coroutine. Runs eagerly until its first suspension and frees itself when done.
+     */
+    struct aus1_task {
+        struct promise_type {
+            aus1_task get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+
+    /**
+     * @brief An AUS1 controller whose data requests can be awaited from a coroutine
+     */
+    class aus1_async_controller {
+        /**
+         * @brief A fetch waiting for, or receiving, its payload. Lives in the awaiting coroutine's frame.
+         */
+        struct pending_fetch {
+            std::coroutine_handle<> handle;
+            uint8_t address;
+            std::chrono::steady_clock::time_point deadline;
+            std::stop_token stop;
+            aus1_fetch_result result;
+        };
+
+    public:
+        /**
+         * @brief Awaitable returned by `fetch`
+         */
+        class fetch_awaitable {
+        public:
+            bool await_ready() const noexcept { return fetch.stop.stop_requested(); }
+            void await_suspend(std::coroutine_handle<> handle);
+            aus1_fetch_result await_resume();
+
+        private:
+            friend class aus1_async_controller;
+
+            fetch_awaitable(aus1_async_controller *owner, uint8_t address, std::chrono::milliseconds timeout, std::stop_token stop);
+
+            aus1_async_controller *owner;
+            pending_fetch fetch;
+        };
+
+        /**
+         * @brief Construct a new async controller driven by `loop`
+         * 
+         * The controller is updated from the loop from the start, so it PINGs and connects before the first fetch.
+         * 
+         * @param loop The event loop to run on. Must outlive the controller.
+         * @param wire The I2C wire to take control of
+         */
+        aus1_async_controller(aus1_event_loop *loop, TwoWire *wire);
+        /**
+         * @brief Cancels every outstanding fetch; their coroutines resume on the next loop iteration
+         */
+        ~aus1_async_controller();
+
+        aus1_async_controller(const aus1_async_controller &) = delete;
+        aus1_async_controller &operator=(const aus1_async_controller &) = delete;
+
+        /**
+         * @brief Fetches one payload from a peripheral. Fetches on the same controller run in the order they were awaited.
+         * 
+         * A fetch waits until its peripheral is connected. Switching to another address PINGs that peripheral first,
+         * so fetches from one address in a row are cheaper than alternating ones.
+         * 
+         * @param address The peripheral's I2C address
+         * @param timeout The time to wait, including time spent queued behind other fetches
+         * @param stop Cancels the fetch when a stop is requested. The stop is noticed at the controller's next update,
+         *             within one PING interval.
+         * @return An awaitable resolving to the fetch result
+         */
+        fetch_awaitable fetch(uint8_t address,
+                              std::chrono::milliseconds timeout = std::chrono::milliseconds(AUS1_ASYNC_DEFAULT_TIMEOUT_MS),
+                              std::stop_token stop = {});
+
+        /**
+         * @brief Gets the underlying controller, e.g. to configure it or check its connection
+         */
+        aus1_controller &controller();
+
+    private:
+        friend class aus1_event_loop;
+
+        /**
+         * @brief The loop this controller runs on
+         */
+        aus1_event_loop *loop;
+        /**
+         * @brief The controller doing the actual work
+         */
+        aus1_controller inner;
+        /**
+         * @brief Outstanding fetches. The front one is handed to `inner` once `front_requested` is set.
+         */
+        std::deque<pending_fetch *> queue;
+        /**
+         * @brief Whether the front of `queue` has been requested from `inner`
+         */
+        bool front_requested;
+
+        /**
+         * @brief Queues a fetch and makes sure the loop is ticking
+         */
+        void enqueue(pending_fetch *fetch);
+        /**
+         * @brief Expires fetches, issues the next request once its peripheral is connected and updates the controller
+         * 
+         * @param now The current time
+         * @param poll_interval The polling period used while the controller is waiting on the bus
+         * @return When the controller next needs a tick
+         */
+        std::chrono::steady_clock::time_point tick(std::chrono::steady_clock::time_point now,
+                                                   std::chrono::microseconds poll_interval);
+        /**
+         * @brief Completes a fetch and schedules its coroutine to resume
+         */
+        void finish(pending_fetch *fetch, aus1_fetch_status status);
+        /**
+         * @brief Receives the payload for the front fetch
+         */
+        static void receive(void *context, uint8_t *buf, size_t data_size, size_t buf_size);
+    };
+
+    /**
+     * @brief A single-threaded epoll loop that drives async controllers
+     * 
+     * The loop only wakes when a controller's `update()` deadline or a fetch timeout is due, so between fetches
+     * it sleeps in `epoll_wait` except for each controller's PINGs (see `aus1_controller::set_ping_interval`).
+     * `fd()` becomes readable whenever the loop has work, so it can be nested inside another event loop.
+     */
+    class aus1_event_loop {
+    public:
+        aus1_event_loop();
+        ~aus1_event_loop();
+
+        aus1_event_loop(const aus1_event_loop &) = delete;
+        aus1_event_loop &operator=(const aus1_event_loop &) = delete;
+
+        /**
+         * @brief Whether the loop's file descriptors were created
+         */
+        bool valid() const;
+
+        /**
+         * @brief Gets a file descriptor that is readable when `run_once` has work to do
+         */
+        int fd() const;
+
+        /**
+         * @brief Sets the shortest time between controller updates
+         * 
+         * Host buses cannot raise a wake event, so this is also how often a controller waiting on a reply is polled.
+         * 
+         * @param interval The interval in microseconds
+         */
+        void set_tick_interval(unsigned long interval);
+
+        /**
+         * @brief Waits for and handles events
+         * 
+         * @param timeout_ms The longest time to wait, or -1 to wait indefinitely
+         * @return Whether the loop can keep running
+         */
+        bool run_once(int timeout_ms);
+        /**
+         * @brief Handles events until `stop` is called
+         */
+        void run();
+        /**
+         * @brief Makes `run` return. Safe to call from any thread.
+         */
+        void stop();
+
+    private:
+        friend class aus1_async_controller;
+
+        int epoll_fd;
+        int timer_fd;
+        int wake_fd;
+
+        /**
+         * @brief The shortest time between controller updates, in microseconds
+         */
+        unsigned long tick_interval;
+        /**
+         * @brief When the tick timer next fires, or `time_point::max()` if it is disarmed
+         */
+        std::chrono::steady_clock::time_point timer_deadline;
+
+        /**
+         * @brief Set by `stop`
+         */
+        std::atomic<bool> stopping;
+
+        /**
+         * @brief A controller driven by the loop
+         */
+        struct active_controller {
+            aus1_async_controller *controller;
+            /**
+             * @brief When the controller next needs a tick
+             */
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        /**
+         * @brief Every controller driven by the loop, from construction until destruction
+         */
+        std::vector<active_controller> active;
+        /**
+         * @brief Coroutines to resume once the current tick is done
+         */
+        std::vector<std::coroutine_handle<>> ready;
+
+        /**
+         * @brief Adds a controller to the loop, or ticks it promptly if it is already there
+         */
+        void activate(aus1_async_controller *controller);
+        /**
+         * @brief Removes a controller that is being destroyed
+         */
+        void detach(aus1_async_controller *controller);
+        /**
+         * @brief Updates every due controller and resumes finished fetches
+         */
+        void tick();
+        /**
+         * @brief Sets the tick timer to fire at `deadline`, or disarms it for `time_point::max()`
+         */
+        void arm_timer(std::chrono::steady_clock::time_point deadline);
+    };
+}
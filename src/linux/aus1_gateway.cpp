@@ -0,0 +1,280 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "aus1_gateway.h"
+
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace superi2c {
+    static uint64_t monotonic_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    }
+
+    aus1_gateway_region::aus1_gateway_region()
+        : base(nullptr),
+          length(0),
+          owner(false) {}
+
+    aus1_gateway_region::~aus1_gateway_region() { close(); }
+
+    bool aus1_gateway_region::create(const char *name, uint32_t slot_count) {
+        close();
+
+        // Exclusive, so a second gateway cannot take over, and wipe, a region that readers are already mapping
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd < 0) return false;
+
+        size_t new_length = sizeof(aus1_gateway_header) + slot_count * sizeof(aus1_gateway_slot);
+        if (ftruncate(fd, new_length) != 0) { // a new object is empty, so every slot starts zeroed
+            ::close(fd);
+            shm_unlink(name);
+            return false;
+        }
+
+        void *mapping = mmap(nullptr, new_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            shm_unlink(name);
+            return false;
+        }
+
+        base = (uint8_t *) mapping;
+        length = new_length;
+        owner = true;
+        this->name = name;
+
+        for (uint32_t i = 0; i < slot_count; i++) {
+            new (slot_address(i)) aus1_gateway_slot();
+        }
+
+        aus1_gateway_header *header = (aus1_gateway_header *) base;
+        header->version = AUS1_GATEWAY_VERSION;
+        header->slot_count = slot_count;
+        header->slot_size = sizeof(aus1_gateway_slot);
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic = AUS1_GATEWAY_MAGIC; // written last; readers reject the region until it is set
+
+        return true;
+    }
+
+    bool aus1_gateway_region::remove(const char *name) { return shm_unlink(name) == 0; }
+
+    bool aus1_gateway_region::open(const char *name) {
+        close();
+
+        int fd = shm_open(name, O_RDONLY, 0);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(aus1_gateway_header)) {
+            ::close(fd);
+            return false;
+        }
+
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) return false;
+
+        const aus1_gateway_header *header = (const aus1_gateway_header *) mapping;
+        if (header->magic != AUS1_GATEWAY_MAGIC
+            || header->version != AUS1_GATEWAY_VERSION
+            || header->slot_size != sizeof(aus1_gateway_slot)
+            || sizeof(aus1_gateway_header) + header->slot_count * sizeof(aus1_gateway_slot) > (size_t) st.st_size) {
+            munmap(mapping, st.st_size);
+            return false;
+        }
+
+        base = (uint8_t *) mapping;
+        length = st.st_size;
+        owner = false;
+        this->name = name;
+
+        return true;
+    }
+
+    void aus1_gateway_region::close() {
+        if (!base) return;
+
+        munmap(base, length);
+        if (owner) shm_unlink(name.c_str());
+
+        base = nullptr;
+        length = 0;
+        owner = false;
+        name.clear();
+    }
+
+    bool aus1_gateway_region::valid() const { return base != nullptr; }
+
+    uint32_t aus1_gateway_region::slot_count() const {
+        if (!base) return 0;
+        return ((const aus1_gateway_header *) base)->slot_count;
+    }
+
+    aus1_gateway_slot *aus1_gateway_region::slot(size_t index) const {
+        if (index >= slot_count()) return nullptr;
+        return slot_address(index);
+    }
+
+    aus1_gateway_slot *aus1_gateway_region::slot_address(size_t index) const {
+        return (aus1_gateway_slot *) (base + sizeof(aus1_gateway_header) + index * sizeof(aus1_gateway_slot));
+    }
+
+    size_t aus1_gateway_region::read(size_t index, uint8_t *out, size_t out_len, uint64_t *publish_count) const {
+        const aus1_gateway_slot *s = slot(index);
+        if (!s) return 0;
+
+        uint32_t start;
+        size_t size;
+        uint64_t count;
+        do {
+            start = seqlock_read_begin(s->sequence);
+            size = s->data_size;
+            count = s->publish_count;
+            memcpy(out, s->data, size < out_len ? size : out_len);
+        } while (seqlock_read_retry(s->sequence, start));
+
+        if (publish_count) *publish_count = count;
+        return size;
+    }
+
+    aus1_gateway::aus1_gateway(aus1_gateway_region *region)
+        : region(region),
+          slots_used(0),
+          running(false),
+          poll_interval(AUS1_GATEWAY_DEFAULT_POLL_US) {}
+
+    aus1_gateway::~aus1_gateway() { stop(); }
+
+    bool aus1_gateway::add_bus(TwoWire *wire) {
+        uint8_t address = AUS1_I2C_ADDRESS;
+        return add_bus(wire, &address, 1);
+    }
+
+    bool aus1_gateway::add_bus(TwoWire *wire, const uint8_t *addresses, size_t count) {
+        if (running.load() || count == 0 || slots_used + count > region->slot_count()) return false;
+
+        std::unique_ptr<worker> w(new worker());
+        for (size_t i = 0; i < count; i++) {
+            aus1_gateway_slot *s = region->slot(slots_used++);
+            s->bus = (uint8_t) workers.size();
+            s->address = addresses[i];
+            w->slots.push_back(s);
+        }
+        w->current = 0;
+        w->requested = false;
+        w->turn_started_ms = 0;
+        w->controller.reset(new aus1_controller(wire));
+        w->controller->set_peripheral_address(addresses[0]);
+        workers.push_back(std::move(w));
+
+        return true;
+    }
+
+    void aus1_gateway::set_poll_interval(unsigned long period) { this->poll_interval = period; }
+
+    bool aus1_gateway::start() {
+        if (running.exchange(true)) return false;
+
+        for (std::unique_ptr<worker> &w : workers) {
+            worker *raw = w.get();
+            w->thread = std::thread([this, raw]() { run(raw); });
+        }
+
+        return true;
+    }
+
+    void aus1_gateway::stop() {
+        if (!running.exchange(false)) return;
+
+        for (std::unique_ptr<worker> &w : workers) {
+            if (w->thread.joinable()) w->thread.join();
+        }
+    }
+
+    void aus1_gateway::run(worker *w) {
+        aus1_controller *controller = w->controller.get();
+        w->turn_started_ms = millis();
+
+        while (running.load(std::memory_order_relaxed)) {
+            unsigned long delay = controller->update();
+
+            if (!controller->has_receiver() && controller->get_state() == aus1_controller_state::IDLE) {
+                // A turn ends once its request does, or if the device does not connect in time
+                if (w->requested
+                    || (!controller->connected() && millis() - w->turn_started_ms > AUS1_GATEWAY_CONNECT_TIMEOUT_MS)) {
+                    next_device(w);
+                }
+
+                // Keep a request queued at all times so each payload is fetched once, here, instead of by every consumer
+                if (controller->connected()) {
+                    controller->request_data(&aus1_gateway::publish, w);
+                    w->requested = true;
+                    continue; // start it on the next update rather than after a sleep
+                }
+            }
+
+            // Sleep until the controller has work due, but no longer than the poll interval:
+            // host buses cannot wake the worker, and `stop()` waits for it
+            unsigned long sleep_us = poll_interval;
+            if (delay != AUS1_NO_DEADLINE && delay < poll_interval / 1000) sleep_us = delay * 1000;
+
+            if (sleep_us) {
+                std::this_thread::sleep_for(std::chrono::microseconds(sleep_us));
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void aus1_gateway::next_device(worker *w) {
+        w->current = (w->current + 1) % w->slots.size();
+        w->requested = false;
+        w->turn_started_ms = millis();
+
+        // A new address disconnects the controller until the device answers a PING; a lone device stays connected
+        w->controller->set_peripheral_address(w->slots[w->current]->address);
+    }
+
+    void aus1_gateway::publish(void *context, uint8_t *buf, size_t data_size, size_t /* buf_size */) {
+        worker *w = (worker *) context;
+        if (!buf) return; // failed verification; keep serving the previous payload
+
+        aus1_gateway_slot *s = w->slots[w->current];
+        if (data_size > AUS1_GATEWAY_SLOT_CAPACITY) data_size = AUS1_GATEWAY_SLOT_CAPACITY;
+
+        seqlock_write_begin(s->sequence);
+        s->device_type = w->controller->get_device_type();
+        s->device_version = w->controller->get_device_version();
+        s->data_size = (uint16_t) data_size;
+        s->publish_count++;
+        s->published_ns = monotonic_ns();
+        memcpy(s->data, buf, data_size);
+        seqlock_write_end(s->sequence);
+    }
+}
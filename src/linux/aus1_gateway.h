@@ -0,0 +1,324 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+// Host-side (Linux) gateway. Builds against the `Wire.h` in this directory, which runs
+// `TwoWire` over /dev/i2c-N adapters (i2c_dev.h) or an in-memory bus (i2c_loopback.h).
+
+#include "../arduino/aus1_controller.h"
+#include "../util/seqlock.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Largest payload a slot can hold; AUS1 data sizes are 16-bit
+#define AUS1_GATEWAY_SLOT_CAPACITY 65535
+// Default longest time a worker sleeps between updates
+#define AUS1_GATEWAY_DEFAULT_POLL_US 1000
+// Longest time a device sharing its bus is given to connect before the worker moves on to the next one
+#define AUS1_GATEWAY_CONNECT_TIMEOUT_MS 100
+
+#define AUS1_GATEWAY_MAGIC   0x41555331 // "AUS1"
+#define AUS1_GATEWAY_VERSION 2
+
+namespace superi2c {
+    /**
+     * @brief The latest verified payload of one device, guarded by a seqlock
+     * 
+     * `bus` and `address` are set before the gateway starts and never change. Every other field but `sequence`
+     * may only be read between `seqlock_read_begin` and `seqlock_read_retry`.
+     */
+    struct alignas(64) aus1_gateway_slot {
+        std::atomic<uint32_t> sequence;
+        uint32_t device_type;
+        uint16_t device_version;
+        uint16_t data_size;
+        /**
+         * @brief The index of the device's bus, in the order buses were added
+         */
+        uint8_t bus;
+        /**
+         * @brief The device's I2C address on its bus
+         */
+        uint8_t address;
+        uint16_t reserved;
+        /**
+         * @brief Number of payloads published into this slot
+         */
+        uint64_t publish_count;
+        /**
+         * @brief CLOCK_MONOTONIC time of the latest publish, in nanoseconds
+         */
+        uint64_t published_ns;
+        uint8_t data[AUS1_GATEWAY_SLOT_CAPACITY];
+    };
+
+    /**
+     * @brief The header at the start of a gateway region, followed by `slot_count` slots
+     */
+    struct alignas(64) aus1_gateway_header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slot_count;
+        uint32_t slot_size;
+    };
+
+    /**
+     * @brief A POSIX shared memory region holding one slot per device
+     */
+    class aus1_gateway_region {
+    public:
+        aus1_gateway_region();
+        ~aus1_gateway_region();
+
+        aus1_gateway_region(const aus1_gateway_region &) = delete;
+        aus1_gateway_region &operator=(const aus1_gateway_region &) = delete;
+
+        /**
+         * @brief Creates a region writable by this process
+         * @note Fails if the name is taken, whether by a running gateway or one that exited without closing its
+         *       region; `remove` clears the latter
+         * 
+         * @param name The shared memory object name, e.g. "/aus1-gateway"
+         * @param slot_count The number of device slots
+         * @return Whether the region was created and mapped
+         */
+        bool create(const char *name, uint32_t slot_count);
+        /**
+         * @brief Removes a region left behind by a gateway. Processes that still map it keep their mapping.
+         * 
+         * @param name The shared memory object name
+         * @return Whether a region was removed
+         */
+        static bool remove(const char *name);
+        /**
+         * @brief Maps an existing region read-only
+         * 
+         * @param name The shared memory object name the gateway created
+         * @return Whether the region exists and has a compatible layout
+         */
+        bool open(const char *name);
+        /**
+         * @brief Unmaps the region, and removes it if this process created it
+         */
+        void close();
+
+        /**
+         * @brief Whether a region is currently mapped
+         */
+        bool valid() const;
+
+        /**
+         * @brief Gets the number of slots in the region
+         */
+        uint32_t slot_count() const;
+
+        /**
+         * @brief Gets a slot for publishing or zero-copy reading
+         * 
+         * @param index The slot index
+         * @return The slot, or `nullptr` if out of range
+         */
+        aus1_gateway_slot *slot(size_t index) const;
+
+        /**
+         * @brief Copies a consistent snapshot of a slot's payload
+         * 
+         * @param index The slot index
+         * @param out The buffer to copy the payload into
+         * @param out_len The size of `out`; longer payloads are truncated
+         * @param publish_count Set to the slot's publish count if not `nullptr`
+         * @return The size of the payload, or 0 if nothing was published yet
+         */
+        size_t read(size_t index, uint8_t *out, size_t out_len, uint64_t *publish_count = nullptr) const;
+
+        /**
+         * @brief Reads a slot in place without copying it
+         * 
+         * `visitor(const uint8_t *data, size_t size)` may observe a torn payload and be called again,
+         * so it should not act on what it reads until `view` returns.
+         * 
+         * @param index The slot index
+         * @param visitor The function to call with the payload
+         * @return Whether the slot exists
+         */
+        template <typename Visitor>
+        bool view(size_t index, Visitor &&visitor) const {
+            const aus1_gateway_slot *s = slot(index);
+            if (!s) return false;
+
+            uint32_t start;
+            do {
+                start = seqlock_read_begin(s->sequence);
+                visitor(s->data, (size_t) s->data_size);
+            } while (seqlock_read_retry(s->sequence, start));
+
+            return true;
+        }
+
+    private:
+        /**
+         * @brief The start of the mapping, or `nullptr` when closed
+         */
+        uint8_t *base;
+        /**
+         * @brief The length of the mapping in bytes
+         */
+        size_t length;
+        /**
+         * @brief Whether this process created the region (and should unlink it)
+         */
+        bool owner;
+        /**
+         * @brief The shared memory object name
+         */
+        std::string name;
+
+        /**
+         * @brief Gets the address of a slot without bounds checking
+         */
+        aus1_gateway_slot *slot_address(size_t index) const;
+    };
+
+    /**
+     * @brief Runs one AUS1 controller per bus, each on its own thread, and publishes payloads into a region
+     * 
+     * Each device has its own slot. Devices sharing a bus take turns, one payload each.
+     */
+    class aus1_gateway {
+    public:
+        /**
+         * @brief Construct a new gateway publishing into `region`
+         * 
+         * @param region A region created by this process. Must outlive the gateway.
+         */
+        explicit aus1_gateway(aus1_gateway_region *region);
+        ~aus1_gateway();
+
+        aus1_gateway(const aus1_gateway &) = delete;
+        aus1_gateway &operator=(const aus1_gateway &) = delete;
+
+        /**
+         * @brief Adds a bus with one device on it, at `AUS1_I2C_ADDRESS`
+         * 
+         * @param wire The I2C wire to take control of
+         * @return Whether the bus was added. Fails once started or once every slot is taken.
+         */
+        bool add_bus(TwoWire *wire);
+        /**
+         * @brief Adds a bus with several devices on it. Each device takes the next free slot, in the order given.
+         * @note A device that does not connect within `AUS1_GATEWAY_CONNECT_TIMEOUT_MS` is skipped until its next turn
+         * 
+         * @param wire The I2C wire to take control of
+         * @param addresses The devices' I2C addresses, e.g. found by `aus1_controller::discover()`
+         * @param count The number of addresses
+         * @return Whether the bus was added. Fails once started or if there are not enough free slots.
+         */
+        bool add_bus(TwoWire *wire, const uint8_t *addresses, size_t count);
+
+        /**
+         * @brief Sets the longest time each worker sleeps between updates
+         * 
+         * Workers sleep until their controller's next deadline, capped at this period. It is also how often
+         * a worker waiting on a bus reply polls, since host buses cannot wake it.
+         * 
+         * @param period The period in microseconds; 0 only yields
+         */
+        void set_poll_interval(unsigned long period);
+
+        /**
+         * @brief Starts one worker thread per bus
+         * 
+         * @return Whether the workers were started
+         */
+        bool start();
+        /**
+         * @brief Stops and joins every worker thread
+         */
+        void stop();
+
+    private:
+        /**
+         * @brief The state owned by a single bus thread
+         */
+        struct worker {
+            /**
+             * @brief The slot of each device on the bus, in turn order
+             */
+            std::vector<aus1_gateway_slot *> slots;
+            /**
+             * @brief The index in `slots` of the device whose turn it is
+             */
+            size_t current;
+            /**
+             * @brief Whether the current device's payload was requested, so its turn ends when the request does
+             */
+            bool requested;
+            /**
+             * @brief The millisecond the current device's turn started
+             */
+            unsigned long turn_started_ms;
+            std::unique_ptr<aus1_controller> controller;
+            std::thread thread;
+        };
+
+        /**
+         * @brief The region payloads are published into
+         */
+        aus1_gateway_region *region;
+        /**
+         * @brief One worker per bus, in the order they were added
+         */
+        std::vector<std::unique_ptr<worker>> workers;
+        /**
+         * @brief The number of slots given to devices so far
+         */
+        size_t slots_used;
+        /**
+         * @brief Whether the workers should keep running
+         */
+        std::atomic<bool> running;
+        /**
+         * @brief The longest time workers sleep between updates, in microseconds
+         */
+        unsigned long poll_interval;
+
+        /**
+         * @brief The loop run by each worker thread
+         * 
+         * @param w The worker
+         */
+        void run(worker *w);
+        /**
+         * @brief Ends the current device's turn and points the controller at the next device on the bus
+         * 
+         * @param w The worker
+         */
+        static void next_device(worker *w);
+        /**
+         * @brief Publishes a verified payload into the worker's slot
+         */
+        static void publish(void *context, uint8_t *buf, size_t data_size, size_t buf_size);
+    };
+}
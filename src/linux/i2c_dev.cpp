@@ -0,0 +1,76 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "i2c_dev.h"
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace superi2c {
+    static int transfer(int fd, uint8_t address, uint16_t flags, uint8_t *buf, size_t len) {
+        i2c_msg message = { address, flags, (uint16_t) len, buf };
+        i2c_rdwr_ioctl_data data = { &message, 1 };
+        return ioctl(fd, I2C_RDWR, &data);
+    }
+
+    i2c_dev::i2c_dev() : fd(-1) {}
+
+    i2c_dev::~i2c_dev() { close(); }
+
+    bool i2c_dev::open(const char *path) {
+        close();
+        fd = ::open(path, O_RDWR | O_CLOEXEC);
+        return fd >= 0;
+    }
+
+    void i2c_dev::close() {
+        if (fd < 0) return;
+        ::close(fd);
+        fd = -1;
+    }
+
+    uint8_t i2c_dev::transmit(uint8_t address, const uint8_t *buf, size_t len) {
+        if (fd < 0) return WIRE_STATUS_OTHER;
+        if (len > WIRE_BUFFER_LENGTH) return WIRE_STATUS_TOO_LONG;
+
+        if (transfer(fd, address, 0, (uint8_t *) buf, len) >= 0) return WIRE_STATUS_OK;
+
+        // Map the adapter's errors onto what Arduino's endTransmission() reports
+        switch (errno) {
+            case ENXIO:
+            case EREMOTEIO:
+                return WIRE_STATUS_ADDRESS_NACK;
+            case ETIMEDOUT:
+                return WIRE_STATUS_TIMEOUT;
+            default:
+                return WIRE_STATUS_OTHER;
+        }
+    }
+
+    size_t i2c_dev::receive(uint8_t address, uint8_t *buf, size_t len) {
+        if (fd < 0) return 0;
+        return transfer(fd, address, I2C_M_RD, buf, len) >= 0 ? len : 0;
+    }
+
+    void i2c_dev::set_clock(uint32_t /* rate */) {}
+}
@@ -0,0 +1,67 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+// Linux I2C adapter (/dev/i2c-N) transport for host controllers.
+
+#include "Wire.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace superi2c {
+    /**
+     * @brief Carries transfers over a Linux I2C adapter, as a controller only
+     * @note Discovery replies are written to the controller by peripherals, which an adapter without a slave
+     *       backend cannot receive; use PING-based connections and a fixed peripheral address instead
+     * @note The bus clock cannot be changed from here, so clock tuning has no effect over an adapter
+     *       (see `aus1_controller::enable_clock_tuning`)
+     */
+    class i2c_dev : public i2c_transport {
+    public:
+        i2c_dev();
+        ~i2c_dev() override;
+
+        i2c_dev(const i2c_dev &) = delete;
+        i2c_dev &operator=(const i2c_dev &) = delete;
+
+        /**
+         * @brief Opens an adapter
+         *
+         * @param path The adapter's device node, e.g. `/dev/i2c-1`
+         * @return Whether the adapter could be opened
+         */
+        bool open(const char *path);
+        /**
+         * @brief Closes the adapter, if one is open
+         */
+        void close();
+
+        uint8_t transmit(uint8_t address, const uint8_t *buf, size_t len) override;
+        size_t receive(uint8_t address, uint8_t *buf, size_t len) override;
+        /**
+         * @brief Does nothing: adapters are clocked by their device tree (`clock-frequency`) or module parameters,
+         *        and Linux offers no way to change the rate from user space
+         */
+        void set_clock(uint32_t rate) override;
+
+    private:
+        int fd;
+    };
+}
@@ -0,0 +1,214 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#include "i2c_loopback.h"
+
+#include "../aus1.h"
+
+#include <cstring>
+#include <ctime>
+
+// Each byte, the address included, is 8 bits plus an acknowledge
+#define BITS_PER_BYTE 9
+// Standard mode, as on Arduino
+#define DEFAULT_CLOCK_RATE 100000
+
+namespace superi2c {
+    static uint64_t transfer_ns_at(uint32_t rate, size_t len) { return (uint64_t) (len + 1) * BITS_PER_BYTE * 1000000000ull / rate; }
+
+    static uint64_t monotonic_ns() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+    }
+
+    i2c_loopback_bus::i2c_loopback_bus()
+        : timing(i2c_loopback_timing::INSTANT),
+          clock_rate(DEFAULT_CLOCK_RATE),
+          busy_ns(0),
+          flipped_bits(0),
+          tracing(false) {}
+
+    uint8_t i2c_loopback_bus::transmit(uint8_t address, const uint8_t *buf, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t start_ns = now_ns();
+
+        uint8_t bytes[WIRE_BUFFER_LENGTH];
+        memcpy(bytes, buf, len);
+        corrupt(bytes, len);
+
+        bool acknowledged = false;
+        if (address == AUS1_GENERAL_CALL_ADDRESS) {
+            for (const target &t : targets) {
+                if (!t.wire->generalCallEnabled()) continue;
+                t.wire->deliver_write(bytes, len);
+                acknowledged = true;
+            }
+        } else if (TwoWire *wire = find(address)) {
+            wire->deliver_write(bytes, len);
+            acknowledged = true;
+        }
+
+        finish(address, false, acknowledged ? len : 0, start_ns); // an unacknowledged address ends the transfer
+        return acknowledged ? WIRE_STATUS_OK : WIRE_STATUS_ADDRESS_NACK;
+    }
+
+    size_t i2c_loopback_bus::receive(uint8_t address, uint8_t *buf, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t start_ns = now_ns();
+
+        TwoWire *wire = find(address);
+        if (!wire) {
+            finish(address, true, 0, start_ns);
+            return 0;
+        }
+
+        // The controller clocks out every byte it asked for; a target with nothing left to send leaves the bus high
+        size_t count = wire->answer_read(buf, len);
+        memset(buf + count, 0xFF, len - count);
+        corrupt(buf, len);
+
+        finish(address, true, len, start_ns);
+        return len;
+    }
+
+    void i2c_loopback_bus::set_clock(uint32_t rate) {
+        std::lock_guard<std::mutex> lock(mutex);
+        clock_rate = rate;
+    }
+
+    bool i2c_loopback_bus::attach(uint8_t address, TwoWire *wire) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (target &t : targets) {
+            if (t.wire == wire) {
+                t.address = address;
+                return true;
+            }
+        }
+        targets.push_back({ address, wire });
+        return true;
+    }
+
+    void i2c_loopback_bus::detach(TwoWire *wire) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < targets.size(); i++) {
+            if (targets[i].wire == wire) {
+                targets.erase(targets.begin() + i);
+                return;
+            }
+        }
+    }
+
+    void i2c_loopback_bus::set_timing(i2c_loopback_timing timing) {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->timing = timing;
+    }
+
+    void i2c_loopback_bus::set_bit_error_rate(uint32_t rate, double bit_error_rate) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (error_model &model : error_models) {
+            if (model.rate == rate) {
+                model.bit_error_rate = bit_error_rate;
+                return;
+            }
+        }
+        error_models.push_back({ rate, bit_error_rate });
+    }
+
+    void i2c_loopback_bus::seed(uint32_t seed) {
+        std::lock_guard<std::mutex> lock(mutex);
+        engine.seed(seed);
+    }
+
+    void i2c_loopback_bus::set_trace(bool enabled) {
+        std::lock_guard<std::mutex> lock(mutex);
+        tracing = enabled;
+    }
+
+    std::vector<i2c_loopback_transfer> i2c_loopback_bus::get_trace() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return trace;
+    }
+
+    void i2c_loopback_bus::clear_trace() {
+        std::lock_guard<std::mutex> lock(mutex);
+        trace.clear();
+    }
+
+    uint32_t i2c_loopback_bus::get_clock() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return clock_rate;
+    }
+
+    uint64_t i2c_loopback_bus::get_busy_ns() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return busy_ns;
+    }
+
+    uint64_t i2c_loopback_bus::get_flipped_bits() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return flipped_bits;
+    }
+
+    uint64_t i2c_loopback_bus::transfer_ns(size_t len) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return transfer_ns_at(clock_rate, len);
+    }
+
+    TwoWire *i2c_loopback_bus::find(uint8_t address) const {
+        for (const target &t : targets) {
+            if (t.address == address) return t.wire;
+        }
+        return nullptr;
+    }
+
+    void i2c_loopback_bus::corrupt(uint8_t *buf, size_t len) {
+        double bit_error_rate = 0;
+        for (const error_model &model : error_models) {
+            if (model.rate == clock_rate) bit_error_rate = model.bit_error_rate;
+        }
+        if (bit_error_rate <= 0) return;
+
+        std::bernoulli_distribution flip(bit_error_rate);
+        for (size_t i = 0; i < len; i++) {
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                if (!flip(engine)) continue;
+                buf[i] ^= (uint8_t) (1 << bit);
+                flipped_bits++;
+            }
+        }
+    }
+
+    void i2c_loopback_bus::finish(uint8_t address, bool read, size_t len, uint64_t start_ns) {
+        uint64_t duration = transfer_ns_at(clock_rate, len);
+        busy_ns += duration;
+
+        if (timing == i2c_loopback_timing::ADVANCE_CLOCK) {
+            // Advance by whole microseconds of the total, so fractions are not lost across transfers
+            host_clock_advance((unsigned long) ((busy_ns / 1000) - ((busy_ns - duration) / 1000)));
+        } else if (timing == i2c_loopback_timing::REAL_TIME) {
+            while (monotonic_ns() - start_ns < duration) {} // too short to sleep for accurately
+        }
+
+        if (tracing) trace.push_back({ address, read, (uint8_t) len, start_ns, now_ns() });
+    }
+
+    uint64_t i2c_loopback_bus::now_ns() const {
+        return timing == i2c_loopback_timing::ADVANCE_CLOCK ? (uint64_t) micros() * 1000 : monotonic_ns();
+    }
+}
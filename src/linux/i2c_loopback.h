@@ -0,0 +1,164 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+// In-memory I2C bus for running AUS1 controllers and peripherals against each other on the host,
+// e.g. in tests and benchmarks. Every wire on the bus shares it as its transport.
+
+#include "Wire.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <vector>
+
+namespace superi2c {
+    /**
+     * @brief How long transfers on a loopback bus take
+     */
+    enum class i2c_loopback_timing {
+        INSTANT,       // transfers take no time
+        ADVANCE_CLOCK, // transfers move the manual host clock (see `host_clock_set_manual`) forward by their bus time
+        REAL_TIME      // transfers spin until their bus time has passed
+    };
+
+    /**
+     * @brief A finished transfer, as recorded by the bus trace
+     */
+    struct i2c_loopback_transfer {
+        uint8_t address;
+        bool read;
+        uint8_t length;
+        /**
+         * @brief When the transfer started and ended, in nanoseconds. Manual clock time under `ADVANCE_CLOCK`,
+         *        otherwise monotonic time.
+         */
+        uint64_t start_ns;
+        uint64_t end_ns;
+    };
+
+    /**
+     * @brief An I2C bus held in memory
+     *
+     * Targets answer as on AVR: writes are handed to the target wire's receive callback, and dropped (though still
+     * acknowledged) if it has none or has not read the previous transfer yet. Reads are answered by its request
+     * callback, padded with `0xFF` when it writes less than was asked for.
+     * Transfers are serialized, so wires may be driven from different threads.
+     */
+    class i2c_loopback_bus : public i2c_transport {
+    public:
+        i2c_loopback_bus();
+
+        uint8_t transmit(uint8_t address, const uint8_t *buf, size_t len) override;
+        size_t receive(uint8_t address, uint8_t *buf, size_t len) override;
+        void set_clock(uint32_t rate) override;
+        bool attach(uint8_t address, TwoWire *wire) override;
+        void detach(TwoWire *wire) override;
+
+        /**
+         * @brief Sets how long transfers take
+         *
+         * @param timing The timing
+         */
+        void set_timing(i2c_loopback_timing timing);
+        /**
+         * @brief Flips bits in transferred bytes at random, to model a noisy bus
+         *
+         * @param rate The clock rate in Hz the error rate applies to
+         * @param bit_error_rate The chance of each data bit being flipped
+         */
+        void set_bit_error_rate(uint32_t rate, double bit_error_rate);
+        /**
+         * @brief Seeds the error model
+         *
+         * @param seed The seed
+         */
+        void seed(uint32_t seed);
+        /**
+         * @brief Starts or stops recording finished transfers
+         *
+         * @param enabled Whether to record transfers
+         */
+        void set_trace(bool enabled);
+        /**
+         * @brief Gets the transfers recorded since the trace was last cleared
+         */
+        std::vector<i2c_loopback_transfer> get_trace();
+        /**
+         * @brief Drops the recorded transfers
+         */
+        void clear_trace();
+
+        /**
+         * @brief Gets the current clock rate in Hz
+         */
+        uint32_t get_clock() const;
+        /**
+         * @brief Gets the total time spent transferring, in nanoseconds
+         */
+        uint64_t get_busy_ns() const;
+        /**
+         * @brief Gets the number of bits the error model has flipped
+         */
+        uint64_t get_flipped_bits() const;
+        /**
+         * @brief Gets the time a transfer takes at the current clock rate
+         *
+         * @param len The number of data bytes
+         * @return The time in nanoseconds
+         */
+        uint64_t transfer_ns(size_t len) const;
+
+    private:
+        struct target {
+            uint8_t address;
+            TwoWire *wire;
+        };
+
+        struct error_model {
+            uint32_t rate;
+            double bit_error_rate;
+        };
+
+        mutable std::mutex mutex;
+        std::vector<target> targets;
+        std::vector<error_model> error_models;
+        std::minstd_rand engine;
+
+        i2c_loopback_timing timing;
+        uint32_t clock_rate;
+        uint64_t busy_ns;
+        uint64_t flipped_bits;
+
+        bool tracing;
+        std::vector<i2c_loopback_transfer> trace;
+
+        TwoWire *find(uint8_t address) const;
+        /**
+         * @brief Flips bits according to the error model for the current clock rate
+         */
+        void corrupt(uint8_t *buf, size_t len);
+        /**
+         * @brief Accounts for a transfer's bus time, and records it
+         */
+        void finish(uint8_t address, bool read, size_t len, uint64_t start_ns);
+        uint64_t now_ns() const;
+    };
+}
@@ -0,0 +1,55 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static const uint16_t crc_16_ccitt_nibble_tab[] = { /* CRC polynomial 0x1021, one entry per nibble */
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+/**
+ * @brief Folds a buffer into a running CRC-16/CCITT-FALSE
+ * @note Uses a 16-entry nibble table to keep the flash cost small on 8-bit parts
+ * 
+ * @param crc The running CRC, starting at `0xFFFF`
+ * @param buf The buffer to hash
+ * @param len The length of the buffer
+ * @return The updated running CRC, which is also the final hash
+ */
+static inline uint16_t crc16_update(uint16_t crc, const uint8_t *buf, size_t len) {
+    for (; len; --len, ++buf) {
+        crc = (uint16_t) ((crc << 4) ^ crc_16_ccitt_nibble_tab[((crc >> 12) ^ (*buf >> 4)) & 0x0f]);
+        crc = (uint16_t) ((crc << 4) ^ crc_16_ccitt_nibble_tab[((crc >> 12) ^ (*buf & 0x0f)) & 0x0f]);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Provides the CRC-16/CCITT-FALSE hash of a buffer
+ * 
+ * @param buf The buffer to hash
+ * @param len The length of the buffer
+ */
+static inline uint16_t crc16buf(const uint8_t *buf, size_t len) {
+    return crc16_update(0xFFFF, buf, len);
+}
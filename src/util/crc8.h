@@ -0,0 +1,55 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+static const uint8_t crc_8_nibble_tab[] = { /* CRC polynomial 0x07, one entry per nibble */
+    0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15,
+    0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d
+};
+
+/**
+ * @brief Folds a buffer into a running CRC-8 (polynomial 0x07, as used by SMBus)
+ * 
+ * @param crc The running CRC, starting at `0x00`
+ * @param buf The buffer to hash
+ * @param len The length of the buffer
+ * @return The updated running CRC, which is also the final hash
+ */
+static inline uint8_t crc8_update(uint8_t crc, const uint8_t *buf, size_t len) {
+    for (; len; --len, ++buf) {
+        crc ^= *buf;
+        crc = (uint8_t) ((crc << 4) ^ crc_8_nibble_tab[crc >> 4]);
+        crc = (uint8_t) ((crc << 4) ^ crc_8_nibble_tab[crc >> 4]);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Provides the CRC-8 hash of a buffer
+ * 
+ * @param buf The buffer to hash
+ * @param len The length of the buffer
+ */
+static inline uint8_t crc8buf(const uint8_t *buf, size_t len) {
+    return crc8_update(0x00, buf, len);
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @brief Accumulates how much of the elapsed time was spent active
+ * @note Timestamps are in microseconds and may wrap, as with Arduino's `micros()`.
+ *       Active periods may nest, as when an interrupt lands inside `update()`; only the outermost one is counted.
+ */
+typedef struct {
+    uint32_t started_us;
+    uint32_t active_since_us;
+    uint32_t active_us;
+    uint32_t calls;
+    uint8_t depth;
+} duty_cycle_meter;
+
+/**
+ * @brief Starts measuring from scratch
+ * 
+ * @param meter The meter
+ * @param now_us The current time in microseconds
+ */
+static inline void duty_cycle_reset(duty_cycle_meter *meter, uint32_t now_us) {
+    meter->started_us = now_us;
+    meter->active_since_us = now_us;
+    meter->active_us = 0;
+    meter->calls = 0;
+    meter->depth = 0;
+}
+
+/**
+ * @brief Marks the start of an active period
+ * 
+ * @param meter The meter
+ * @param now_us The current time in microseconds
+ */
+static inline void duty_cycle_begin(duty_cycle_meter *meter, uint32_t now_us) {
+    if (meter->depth++ == 0) meter->active_since_us = now_us;
+}
+
+/**
+ * @brief Marks the end of an active period
+ * 
+ * @param meter The meter
+ * @param now_us The current time in microseconds
+ */
+static inline void duty_cycle_end(duty_cycle_meter *meter, uint32_t now_us) {
+    if (meter->depth == 0 || --meter->depth != 0) return; // unmatched, or still inside an outer period
+    meter->active_us += now_us - meter->active_since_us;
+    meter->calls++;
+}
+
+/**
+ * @brief Provides the share of time spent active since the meter was reset
+ * 
+ * @param meter The meter
+ * @param now_us The current time in microseconds
+ * @return The duty cycle in parts per thousand
+ */
+static inline uint16_t duty_cycle_permille(const duty_cycle_meter *meter, uint32_t now_us) {
+    uint32_t elapsed_us = now_us - meter->started_us;
+    if (elapsed_us == 0) return 0;
+
+    return (uint16_t) (((uint64_t) meter->active_us * 1000) / elapsed_us);
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * @brief Folds a buffer into a running Fletcher-16 checksum
+ * @note The running sums are packed as `(sum2 << 8) | sum1`, which is also the final checksum
+ * 
+ * @param sums The running sums, starting at `0x0000`
+ * @param buf The buffer to checksum
+ * @param len The length of the buffer
+ * @return The updated running sums
+ */
+static inline uint16_t fletcher16_update(uint16_t sums, const uint8_t *buf, size_t len) {
+    uint16_t sum1 = sums & 0xFF;
+    uint16_t sum2 = sums >> 8;
+
+    // Sums stay below 16 bits for 20 bytes, so the modulo only runs once per block
+    while (len) {
+        size_t block = len < 20 ? len : 20;
+        len -= block;
+
+        for (; block; --block, ++buf) {
+            sum1 += *buf;
+            sum2 += sum1;
+        }
+        sum1 %= 255;
+        sum2 %= 255;
+    }
+
+    return (uint16_t) ((sum2 << 8) | sum1);
+}
+
+/**
+ * @brief Provides the Fletcher-16 checksum of a buffer
+ * 
+ * @param buf The buffer to checksum
+ * @param len The length of the buffer
+ */
+static inline uint16_t fletcher16buf(const uint8_t *buf, size_t len) {
+    return fletcher16_update(0x0000, buf, len);
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+
+#pragma once
+
+#include <stdint.h>
+
+// Wire callbacks are plain functions with no context, so an object cannot register its own. Classes that need one
+// per object route them through a fixed table instead: each slot has its own trampoline, which calls whichever
+// object holds the slot.
+
+namespace superi2c {
+    template <typename T, uint8_t N>
+    class instance_table {
+    public:
+        typedef void (*handler)();
+        typedef void (*int_handler)(int);
+
+        /**
+         * @brief Takes the first free slot
+         * 
+         * @param instance The object the slot's trampolines call
+         * @return The slot, or `N` if every slot is taken
+         */
+        static uint8_t claim(T *instance) {
+            for (uint8_t i = 0; i < N; i++) {
+                if (!instances[i]) {
+                    instances[i] = instance;
+                    return i;
+                }
+            }
+            return N;
+        }
+
+        /**
+         * @brief Frees a slot, so its trampolines do nothing until it is claimed again
+         * 
+         * @param slot The slot, or `N` for none
+         */
+        static void release(uint8_t slot) {
+            if (slot < N) instances[slot] = nullptr;
+        }
+
+        /**
+         * @brief Gets the trampoline calling `method` on the object in a slot
+         * 
+         * @param slot The slot
+         * @return The trampoline, or `nullptr` if the slot does not exist
+         */
+        template <void (T::*method)()>
+        static handler trampoline(uint8_t slot) { return slot_trampolines<0>::template find<method>(slot); }
+
+        /**
+         * @brief Gets the trampoline calling `method` on the object in a slot, passing its argument on
+         * 
+         * @param slot The slot
+         * @return The trampoline, or `nullptr` if the slot does not exist
+         */
+        template <void (T::*method)(int)>
+        static int_handler int_trampoline(uint8_t slot) { return slot_trampolines<0>::template find_int<method>(slot); }
+
+    private:
+        static T *instances[N];
+
+        template <uint8_t I, bool end = (I >= N)>
+        struct slot_trampolines {
+            template <void (T::*method)()>
+            static void call() {
+                T *instance = instances[I];
+                if (instance) (instance->*method)();
+            }
+
+            template <void (T::*method)(int)>
+            static void call_int(int argument) {
+                T *instance = instances[I];
+                if (instance) (instance->*method)(argument);
+            }
+
+            template <void (T::*method)()>
+            static handler find(uint8_t slot) {
+                return slot == I ? &call<method> : slot_trampolines<I + 1>::template find<method>(slot);
+            }
+
+            template <void (T::*method)(int)>
+            static int_handler find_int(uint8_t slot) {
+                return slot == I ? &call_int<method> : slot_trampolines<I + 1>::template find_int<method>(slot);
+            }
+        };
+
+        template <uint8_t I>
+        struct slot_trampolines<I, true> {
+            template <void (T::*method)()>
+            static handler find(uint8_t) { return nullptr; }
+
+            template <void (T::*method)(int)>
+            static int_handler find_int(uint8_t) { return nullptr; }
+        };
+    };
+
+    template <typename T, uint8_t N>
+    T *instance_table<T, N>::instances[N];
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright 2025 John Jerney
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// A sequence lock: one writer, any number of readers, readers never block the writer.
+// The writer makes the sequence odd while it is modifying the guarded data and even once it is done.
+// A reader that saw the same even sequence before and after copying the data got a consistent copy.
+
+namespace superi2c {
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock sequences must be lock-free to be shared across processes");
+
+    /**
+     * @brief Marks the start of a write to seqlock-guarded data
+     * 
+     * @param sequence The sequence guarding the data
+     */
+    inline void seqlock_write_begin(std::atomic<uint32_t> &sequence) {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /**
+     * @brief Marks the end of a write to seqlock-guarded data
+     * 
+     * @param sequence The sequence guarding the data
+     */
+    inline void seqlock_write_end(std::atomic<uint32_t> &sequence) {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Waits for any in-progress write to finish and marks the start of a read
+     * 
+     * @param sequence The sequence guarding the data
+     * @return The sequence to hand to `seqlock_read_retry` once the data has been read
+     */
+    inline uint32_t seqlock_read_begin(const std::atomic<uint32_t> &sequence) {
+        uint32_t start;
+        while ((start = sequence.load(std::memory_order_acquire)) & 1) {} // writer in progress
+
+        return start;
+    }
+
+    /**
+     * @brief Checks whether the data read since `seqlock_read_begin` may be torn
+     * 
+     * @param sequence The sequence guarding the data
+     * @param start The value returned by `seqlock_read_begin`
+     * @return Whether the read must be retried
+     */
+    inline bool seqlock_read_retry(const std::atomic<uint32_t> &sequence, uint32_t start) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return sequence.load(std::memory_order_relaxed) != start;
+    }
+}
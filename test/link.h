@@ -0,0 +1,114 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+#pragma once
+
+// A controller and a peripheral on one loopback bus, stepped on the manual host clock, for tests and benchmarks.
+
+#include "arduino/aus1_controller.h"
+#include "arduino/aus1_peripheral.h"
+#include "i2c_loopback.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace superi2c {
+    class aus1_link {
+    public:
+        i2c_loopback_bus bus;
+        TwoWire controller_wire;
+        TwoWire peripheral_wire;
+        aus1_controller controller;
+        aus1_peripheral peripheral;
+
+        /**
+         * @param provide The peripheral's payload
+         * @param peripheral_address The address the peripheral is begun on
+         */
+        explicit aus1_link(provide_data_response provide, uint8_t peripheral_address = 0x20)
+            : controller_wire(&bus),
+              peripheral_wire(&bus),
+              controller(&controller_wire),
+              peripheral(&peripheral_wire, 1, 1, provide) {
+            host_clock_set_manual(true);
+            bus.set_timing(i2c_loopback_timing::ADVANCE_CLOCK); // transfers take their bus time on the manual clock
+
+            controller_wire.begin(AUS1_I2C_ADDRESS);
+            peripheral_wire.begin(peripheral_address);
+            controller.set_peripheral_address(peripheral_address);
+            peripheral.set_address(peripheral_address);
+        }
+
+        ~aus1_link() { host_clock_set_manual(false); }
+
+        /**
+         * @brief Updates both ends, then moves the clock to the controller's next deadline, at most a millisecond away
+         * @note Always moves the clock a little, so loops bounded by simulated time end even if nothing is due
+         */
+        void step() {
+            unsigned long delay = controller.update();
+            peripheral.update();
+            host_clock_advance(delay == 0 ? 1 : delay == AUS1_NO_DEADLINE || delay > 1 ? 1000 : delay * 1000);
+        }
+
+        /**
+         * @brief Steps until the controller is connected
+         *
+         * @param budget_ms The longest simulated time to wait
+         * @return Whether it connected
+         */
+        bool connect(unsigned long budget_ms) {
+            unsigned long start = millis();
+            while (!controller.connected() && millis() - start < budget_ms) step();
+            return controller.connected();
+        }
+
+        /**
+         * @brief Requests a payload and steps until it is delivered
+         *
+         * @param out Set to the payload if it verified
+         * @param budget_ms The longest simulated time to wait
+         * @return Whether a verified payload was delivered
+         */
+        bool fetch(std::vector<uint8_t> &out, unsigned long budget_ms) {
+            delivered = false;
+            verified = false;
+            received = &out;
+            controller.request_data(&aus1_link::receive, this);
+
+            // The controller drops the request without delivering when the peripheral's reply is invalid
+            unsigned long start = millis();
+            while (!delivered && controller.has_receiver() && millis() - start < budget_ms) step();
+
+            if (!delivered) controller.cancel_request(); // leave the controller idle
+            return verified;
+        }
+
+    private:
+        bool delivered = false;
+        bool verified = false;
+        std::vector<uint8_t> *received = nullptr;
+
+        static void receive(void *context, uint8_t *buf, size_t data_size, size_t /* buf_size */) {
+            aus1_link *link = (aus1_link *) context;
+            link->delivered = true;
+            link->verified = buf != nullptr;
+            if (buf) link->received->assign(buf, buf + data_size);
+        }
+    };
+}
@@ -0,0 +1,181 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// The coroutine API over the loopback bus, on the real clock: each way a fetch can finish, fetches queued on one
+// controller across several peripherals, and an idle controller connecting and staying on the loop's timer.
+
+#include "test.h"
+
+#include "aus1_async.h"
+#include "arduino/aus1_peripheral.h"
+#include "i2c_loopback.h"
+
+using namespace superi2c;
+
+// Each peripheral's payload is its address repeated, so a payload from the wrong one is noticed
+template <uint8_t address, size_t size>
+static buf provide() {
+    uint8_t *data = new uint8_t[size];
+    for (size_t i = 0; i < size; i++) data[i] = (uint8_t) (address + i);
+    return buf{ data, size };
+}
+
+static bool matches(const std::vector<uint8_t> &data, uint8_t address, size_t size) {
+    if (data.size() != size) return false;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] != (uint8_t) (address + i)) return false;
+    }
+    return true;
+}
+
+struct outcome {
+    bool done = false;
+    int order = -1;
+    aus1_fetch_result result;
+};
+
+static int finished;
+
+static aus1_task fetch_into(aus1_async_controller *controller, uint8_t address, std::chrono::milliseconds timeout,
+                            std::stop_token stop, outcome *out) {
+    out->result = co_await controller->fetch(address, timeout, stop);
+    out->order = finished++;
+    out->done = true;
+}
+
+template <typename condition>
+static bool run_until(aus1_event_loop &loop, condition done, unsigned long budget_ms) {
+    unsigned long start = millis();
+    while (!done() && millis() - start < budget_ms) loop.run_once(5);
+    return done();
+}
+
+int main() {
+    i2c_loopback_bus bus;
+    TwoWire controller_wire(&bus);
+    controller_wire.begin(AUS1_I2C_ADDRESS);
+
+    TwoWire wires[3] = { TwoWire(&bus), TwoWire(&bus), TwoWire(&bus) };
+    aus1_peripheral first(&wires[0], 1, 1, &provide<0x20, 100>);
+    aus1_peripheral second(&wires[1], 2, 1, &provide<0x21, 40>);
+    aus1_peripheral large(&wires[2], 3, 1, &provide<0x22, 4096>);
+    for (uint8_t i = 0; i < 3; i++) wires[i].begin(0x20 + i);
+
+    aus1_event_loop loop;
+    CHECK(loop.valid());
+    aus1_async_controller controller(&loop, &controller_wire);
+    controller.controller().set_peripheral_address(0x20);
+
+    // Without any fetch, the loop keeps updating the controller, which PINGs and connects
+    CHECK(run_until(loop, [&] { return controller.controller().connected(); }, 500));
+
+    // OK
+    {
+        outcome out;
+        fetch_into(&controller, 0x20, std::chrono::milliseconds(500), {}, &out);
+        CHECK(run_until(loop, [&] { return out.done; }, 1000));
+        CHECK(out.result.status == aus1_fetch_status::OK);
+        CHECK(matches(out.result.data, 0x20, 100));
+    }
+
+    // Several fetches queued on one controller, across two peripherals, finish in the order they were awaited
+    {
+        outcome outs[6];
+        finished = 0;
+        for (int i = 0; i < 6; i++) {
+            fetch_into(&controller, i % 2 ? 0x21 : 0x20, std::chrono::milliseconds(2000), {}, &outs[i]);
+        }
+        CHECK(run_until(loop, [&] { return outs[5].done; }, 3000));
+        for (int i = 0; i < 6; i++) {
+            CHECK(outs[i].done && outs[i].order == i);
+            CHECK(outs[i].result.status == aus1_fetch_status::OK);
+            CHECK(i % 2 ? matches(outs[i].result.data, 0x21, 40) : matches(outs[i].result.data, 0x20, 100));
+        }
+    }
+
+    // TIMED_OUT: nothing answers at the address, so the fetch never gets past waiting to connect
+    {
+        outcome out;
+        unsigned long start = millis();
+        fetch_into(&controller, 0x30, std::chrono::milliseconds(100), {}, &out);
+        CHECK(run_until(loop, [&] { return out.done; }, 1000));
+        CHECK(out.result.status == aus1_fetch_status::TIMED_OUT);
+        CHECK(millis() - start >= 100 && millis() - start < 200);
+    }
+
+    // CANCELLED before the coroutine suspends: it never waits, nor reaches the queue
+    {
+        std::stop_source source;
+        source.request_stop();
+        outcome out;
+        fetch_into(&controller, 0x20, std::chrono::milliseconds(500), source.get_token(), &out);
+        CHECK(out.done);
+        CHECK(out.result.status == aus1_fetch_status::CANCELLED);
+    }
+
+    // CANCELLED while suspended: noticed at the controller's next update
+    {
+        std::stop_source source;
+        outcome out;
+        fetch_into(&controller, 0x30, std::chrono::milliseconds(5000), source.get_token(), &out);
+        run_until(loop, [] { return false; }, 30);
+        CHECK(!out.done);
+
+        unsigned long start = millis();
+        source.request_stop();
+        CHECK(run_until(loop, [&] { return out.done; }, 1000));
+        CHECK(out.result.status == aus1_fetch_status::CANCELLED);
+        CHECK(millis() - start <= AUS1_DEFAULT_PING_INTERVAL_MS + 10);
+    }
+
+    // DISCONNECTED: the peripheral goes away partway through its stream, and the fetch fails before its timeout
+    {
+        outcome out;
+        fetch_into(&controller, 0x22, std::chrono::milliseconds(5000), {}, &out);
+        CHECK(run_until(loop, [&] {
+            return controller.controller().get_state() == aus1_controller_state::RECEIVING_DATA || out.done;
+        }, 1000));
+        CHECK(!out.done);
+
+        unsigned long start = millis();
+        wires[2].end();
+        CHECK(run_until(loop, [&] { return out.done; }, 1000));
+        CHECK(out.result.status == aus1_fetch_status::DISCONNECTED);
+        CHECK(millis() - start < 100);
+
+        // The next fetch, from a peripheral still there, is unaffected
+        outcome next;
+        fetch_into(&controller, 0x20, std::chrono::milliseconds(500), {}, &next);
+        CHECK(run_until(loop, [&] { return next.done; }, 1000));
+        CHECK(next.result.status == aus1_fetch_status::OK);
+    }
+
+    // Idle, the loop sleeps between the controller's PINGs rather than polling
+    {
+        CHECK(run_until(loop, [&] { return controller.controller().connected(); }, 500));
+        unsigned long start = millis(), wakeups = 0;
+        while (millis() - start < 200) {
+            loop.run_once(-1);
+            wakeups++;
+        }
+        CHECK(controller.controller().connected());
+        CHECK(wakeups <= 2 * (200 / AUS1_DEFAULT_PING_INTERVAL_MS + 1));
+    }
+
+    return 0;
+}
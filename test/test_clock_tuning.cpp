@@ -0,0 +1,117 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Clock tuning on a simulated bus whose error rate depends on the clock rate.
+
+#include "test.h"
+#include "link.h"
+
+using namespace superi2c;
+
+#define PAYLOAD_SIZE 100
+// Parts per thousand
+#define ERROR_BUDGET 50
+#define WINDOW       8
+
+static const uint32_t rates[] = { 100000, 400000, 1000000 };
+
+static buf provide() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = (uint8_t) i;
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+/**
+ * @brief Fetches continuously, as the gateway does, and tallies how long each rate was in use
+ *
+ * @param time_at Set to the milliseconds spent at each rate
+ * @return The number of verified payloads
+ */
+static size_t run(aus1_link &link, unsigned long duration_ms, unsigned long *time_at) {
+    for (size_t i = 0; i < 3; i++) time_at[i] = 0;
+
+    size_t verified = 0;
+    std::vector<uint8_t> data;
+    unsigned long start = millis();
+    while (millis() - start < duration_ms) {
+        unsigned long before = millis();
+        uint32_t rate = link.controller.get_clock_rate();
+
+        if (link.controller.connected()) {
+            if (link.fetch(data, 50)) verified++;
+        } else {
+            link.step();
+        }
+
+        for (size_t i = 0; i < 3; i++) {
+            if (rates[i] == rate) time_at[i] += millis() - before;
+        }
+    }
+    return verified;
+}
+
+int main() {
+    // The fastest rate loses every reply: the link drops there, and tuning must still fall back
+    {
+        aus1_link link(&provide);
+        link.bus.seed(1);
+        link.bus.set_bit_error_rate(1000000, 0.05);
+        CHECK(link.controller.enable_clock_tuning(rates, 3, ERROR_BUDGET, WINDOW));
+        CHECK(link.controller.get_clock_rate() == 100000); // starts conservative
+
+        unsigned long time_at[3];
+        size_t verified = run(link, 20000, time_at);
+
+        // Settles on the fastest rate within budget, only briefly probing the failing one again
+        CHECK(verified > 0);
+        CHECK(time_at[1] > 10 * time_at[2]);
+        CHECK(time_at[1] > 10 * time_at[0]);
+
+        // Each fall back doubles the holdoff, so a rate that keeps failing is probed less and less
+        unsigned long later[3];
+        run(link, 20000, later);
+        CHECK(later[2] < time_at[2]);
+    }
+
+    // Every rate but the slowest is over budget
+    {
+        aus1_link link(&provide);
+        link.bus.seed(2);
+        link.bus.set_bit_error_rate(400000, 0.01);
+        link.bus.set_bit_error_rate(1000000, 0.05);
+        CHECK(link.controller.enable_clock_tuning(rates, 3, ERROR_BUDGET, WINDOW));
+
+        unsigned long time_at[3];
+        run(link, 20000, time_at);
+        CHECK(time_at[0] > 5 * (time_at[1] + time_at[2]));
+    }
+
+    // A clean bus climbs straight to the fastest rate and stays there
+    {
+        aus1_link link(&provide);
+        CHECK(link.controller.enable_clock_tuning(rates, 3, ERROR_BUDGET, WINDOW));
+
+        unsigned long time_at[3];
+        run(link, 5000, time_at);
+        CHECK(link.controller.get_clock_rate() == 1000000);
+        CHECK(link.bus.get_clock() == 1000000);
+        CHECK(time_at[2] > 10 * (time_at[0] + time_at[1]));
+    }
+
+    return 0;
+}
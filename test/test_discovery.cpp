@@ -0,0 +1,185 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Discovery over the loopback bus: finding peripherals, heartbeat rounds, noticing a peripheral that went away,
+// and a full peripheral table. The loopback carries one transfer at a time, so replies never collide and the
+// backoff after a lost arbitration is not exercised here.
+
+#include "test.h"
+#include "link.h"
+
+extern "C" {
+    #include "aus1.h"
+}
+
+#include <memory>
+
+using namespace superi2c;
+
+#define EXTRA_PERIPHERALS 3
+
+static buf provide() {
+    uint8_t *data = new uint8_t[4];
+    for (size_t i = 0; i < 4; i++) data[i] = (uint8_t) i;
+    return buf{ data, 4 };
+}
+
+// A peripheral of its own type on the link's bus, listening for DISCOVER
+struct extra_peripheral {
+    TwoWire wire;
+    aus1_peripheral peripheral;
+
+    extra_peripheral(i2c_loopback_bus *bus, uint8_t address)
+        : wire(bus),
+          peripheral(&wire, address, (uint16_t) (address * 3), &provide) {
+        wire.begin(address);
+        wire.enableGeneralCall(true);
+        peripheral.set_address(address);
+    }
+};
+
+static const aus1_peripheral_entry *find(const aus1_controller &controller, uint8_t address) {
+    for (size_t i = 0; i < controller.get_peripheral_count(); i++) {
+        if (controller.get_peripheral(i)->address == address) return controller.get_peripheral(i);
+    }
+    return nullptr;
+}
+
+static size_t index_of(const aus1_controller &controller, uint8_t address) {
+    for (size_t i = 0; i < controller.get_peripheral_count(); i++) {
+        if (controller.get_peripheral(i)->address == address) return i;
+    }
+    return controller.get_peripheral_count();
+}
+
+// Steps the link and the extra peripherals together
+static void step(aus1_link &link, std::unique_ptr<extra_peripheral> *extras, size_t extra_count) {
+    for (size_t i = 0; i < extra_count; i++) extras[i]->peripheral.update();
+    link.step();
+}
+
+int main() {
+    // Every listening peripheral announces itself with its type and version
+    {
+        aus1_link link(&provide);
+        link.peripheral_wire.enableGeneralCall(true);
+        std::unique_ptr<extra_peripheral> extras[EXTRA_PERIPHERALS];
+        for (size_t i = 0; i < EXTRA_PERIPHERALS; i++) extras[i].reset(new extra_peripheral(&link.bus, 0x21 + i));
+        CHECK(link.connect(1000));
+
+        link.controller.discover();
+        unsigned long start = millis();
+        while (link.controller.get_state() != aus1_controller_state::DISCOVERING && millis() - start < 100) {
+            step(link, extras, EXTRA_PERIPHERALS);
+        }
+        CHECK(link.controller.get_state() == aus1_controller_state::DISCOVERING);
+        while (link.controller.get_state() == aus1_controller_state::DISCOVERING && millis() - start < 1000) {
+            step(link, extras, EXTRA_PERIPHERALS);
+        }
+
+        CHECK(link.controller.get_peripheral_count() == 1 + EXTRA_PERIPHERALS);
+        const aus1_peripheral_entry *entry = find(link.controller, 0x20);
+        CHECK(entry && entry->peripheral_type == 1 && entry->peripheral_version == 1);
+        for (uint8_t address = 0x21; address < 0x21 + EXTRA_PERIPHERALS; address++) {
+            entry = find(link.controller, address);
+            CHECK(entry && entry->peripheral_type == address && entry->peripheral_version == address * 3);
+        }
+        for (size_t i = 0; i < link.controller.get_peripheral_count(); i++) CHECK(link.controller.peripheral_alive(i));
+
+        // A heartbeat round ends as soon as every peripheral has answered, well before its full period
+        link.controller.set_timeout_period(100);
+        link.controller.set_liveness_interval(50);
+        start = millis();
+        while (link.controller.get_state() != aus1_controller_state::DISCOVERING && millis() - start < 200) {
+            step(link, extras, EXTRA_PERIPHERALS);
+        }
+        CHECK(link.controller.get_state() == aus1_controller_state::DISCOVERING);
+        unsigned long round_start = millis();
+        while (link.controller.get_state() == aus1_controller_state::DISCOVERING && millis() - round_start < 1000) {
+            step(link, extras, EXTRA_PERIPHERALS);
+        }
+        CHECK(millis() - round_start <= AUS1_DEFAULT_DISCOVERY_WINDOW_MS + 2);
+
+        // A peripheral that stops answering is no longer alive once a liveness interval, a discovery period and the
+        // timeout have passed, while the others stay alive and keep their rounds going
+        extras[1]->wire.end();
+        start = millis();
+        while (millis() - start < 50 + ((unsigned long) AUS1_DEFAULT_DISCOVERY_WINDOW_MS << AUS1_DISCOVERY_ATTEMPTS) + 100 + 50) {
+            step(link, extras, EXTRA_PERIPHERALS);
+        }
+        CHECK(link.controller.get_peripheral_count() == 1 + EXTRA_PERIPHERALS);
+        CHECK(!link.controller.peripheral_alive(index_of(link.controller, 0x22)));
+        CHECK(link.controller.peripheral_alive(index_of(link.controller, 0x20)));
+        CHECK(link.controller.peripheral_alive(index_of(link.controller, 0x21)));
+        CHECK(link.controller.peripheral_alive(index_of(link.controller, 0x23)));
+    }
+
+    // Once the table is full, new peripherals are left out, but those already in it are still updated
+    {
+        aus1_link link(&provide);
+        TwoWire announcer(&link.bus);
+
+        for (uint8_t i = 0; i < AUS1_MAX_PERIPHERALS + 4; i++) {
+            aus1_announce_packet announce = { (uint8_t) (0x30 + i), i, 1 };
+            uint8_t packet[AUS1_ANNOUNCE_PACKET_SIZE];
+            aus1_encode_announce(packet, &announce);
+            // A write landing while a PING response is still unread is dropped, as on AVR
+            while (link.controller_wire.available()) link.step();
+            announcer.beginTransmission(AUS1_I2C_ADDRESS);
+            announcer.write(packet, AUS1_ANNOUNCE_PACKET_SIZE);
+            CHECK(announcer.endTransmission() == 0);
+            link.step();
+        }
+        CHECK(link.controller.get_peripheral_count() == AUS1_MAX_PERIPHERALS);
+        for (uint8_t i = 0; i < AUS1_MAX_PERIPHERALS; i++) CHECK(find(link.controller, 0x30 + i));
+        CHECK(!find(link.controller, 0x30 + AUS1_MAX_PERIPHERALS));
+        CHECK(link.controller.get_peripheral(AUS1_MAX_PERIPHERALS) == nullptr);
+
+        aus1_announce_packet announce = { 0x30, 77, 2 };
+        uint8_t packet[AUS1_ANNOUNCE_PACKET_SIZE];
+        aus1_encode_announce(packet, &announce);
+        while (link.controller_wire.available()) link.step();
+        announcer.beginTransmission(AUS1_I2C_ADDRESS);
+        announcer.write(packet, AUS1_ANNOUNCE_PACKET_SIZE);
+        CHECK(announcer.endTransmission() == 0);
+        link.step();
+        CHECK(link.controller.get_peripheral_count() == AUS1_MAX_PERIPHERALS);
+        const aus1_peripheral_entry *entry = find(link.controller, 0x30);
+        CHECK(entry && entry->peripheral_type == 77 && entry->peripheral_version == 2);
+    }
+
+    // Replies written faster than the controller updates are kept until it does, not lost to the one Wire buffer
+    {
+        aus1_link link(&provide);
+        TwoWire announcer(&link.bus);
+
+        while (link.controller_wire.available()) link.step();
+        for (uint8_t i = 0; i < 3; i++) {
+            aus1_announce_packet announce = { (uint8_t) (0x40 + i), 5, 5 };
+            uint8_t packet[AUS1_ANNOUNCE_PACKET_SIZE];
+            aus1_encode_announce(packet, &announce);
+            announcer.beginTransmission(AUS1_I2C_ADDRESS);
+            announcer.write(packet, AUS1_ANNOUNCE_PACKET_SIZE);
+            CHECK(announcer.endTransmission() == 0);
+        }
+        link.step();
+        CHECK(link.controller.get_peripheral_count() == 3);
+    }
+
+    return 0;
+}
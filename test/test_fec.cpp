@@ -0,0 +1,125 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// SECDED chunk encoding: every single flipped bit is corrected and every double flip within a codeword is detected.
+
+#include "test.h"
+#include "link.h"
+
+extern "C" {
+    #include "aus1.h"
+}
+
+#include <cstring>
+
+using namespace superi2c;
+
+#define CODEWORD_COUNT (AUS1_DATA_PACKET_SIZE / AUS1_FEC_CODEWORD_SIZE)
+// Bits of a codeword that carry data or check bits; the check byte's top bit is unused
+#define USED_BITS      (AUS1_FEC_CODEWORD_SIZE * 8 - 1)
+#define PAYLOAD_SIZE   500
+
+static void flip(uint8_t *chunk, size_t codeword, size_t bit) {
+    chunk[codeword * AUS1_FEC_CODEWORD_SIZE + bit / 8] ^= (uint8_t) (1 << (bit % 8));
+}
+
+static buf provide() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = (uint8_t) (i * 31 + 7);
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+int main() {
+    uint8_t payload[AUS1_FEC_CHUNK_DATA_SIZE];
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t) (i * 73 + 11);
+
+    uint8_t chunk[AUS1_DATA_PACKET_SIZE];
+    aus1_fec_encode_chunk(chunk, payload);
+
+    // The data bytes are sent as they are, each codeword followed by its check byte
+    for (size_t i = 0; i < CODEWORD_COUNT; i++) {
+        CHECK(memcmp(chunk + i * AUS1_FEC_CODEWORD_SIZE, payload + i * AUS1_FEC_CODEWORD_DATA_SIZE, AUS1_FEC_CODEWORD_DATA_SIZE) == 0);
+    }
+
+    uint8_t decoded[AUS1_FEC_CHUNK_DATA_SIZE];
+    CHECK(aus1_fec_decode_chunk(decoded, chunk) == 0);
+    CHECK(memcmp(decoded, payload, sizeof(payload)) == 0);
+
+    // Every single flipped bit is corrected, check bits included
+    for (size_t codeword = 0; codeword < CODEWORD_COUNT; codeword++) {
+        for (size_t bit = 0; bit < USED_BITS; bit++) {
+            uint8_t corrupted[AUS1_DATA_PACKET_SIZE];
+            memcpy(corrupted, chunk, sizeof(chunk));
+            flip(corrupted, codeword, bit);
+
+            memset(decoded, 0, sizeof(decoded));
+            CHECK(aus1_fec_decode_chunk(decoded, corrupted) == 1);
+            CHECK(memcmp(decoded, payload, sizeof(payload)) == 0);
+        }
+    }
+
+    // One flip in each codeword is still one correction each
+    {
+        uint8_t corrupted[AUS1_DATA_PACKET_SIZE];
+        memcpy(corrupted, chunk, sizeof(chunk));
+        for (size_t codeword = 0; codeword < CODEWORD_COUNT; codeword++) flip(corrupted, codeword, codeword * 13);
+
+        CHECK(aus1_fec_decode_chunk(decoded, corrupted) == CODEWORD_COUNT);
+        CHECK(memcmp(decoded, payload, sizeof(payload)) == 0);
+    }
+
+    // Every pair of flipped bits within a codeword is detected rather than miscorrected
+    for (size_t codeword = 0; codeword < CODEWORD_COUNT; codeword++) {
+        for (size_t a = 0; a < USED_BITS; a++) {
+            for (size_t b = a + 1; b < USED_BITS; b++) {
+                uint8_t corrupted[AUS1_DATA_PACKET_SIZE];
+                memcpy(corrupted, chunk, sizeof(chunk));
+                flip(corrupted, codeword, a);
+                flip(corrupted, codeword, b);
+
+                CHECK(aus1_fec_decode_chunk(decoded, corrupted) == -1);
+            }
+        }
+    }
+
+    // Over a noisy bus, FEC links keep delivering verified payloads and count what they corrected
+    {
+        aus1_link link(&provide);
+        link.bus.seed(3);
+        link.bus.set_bit_error_rate(100000, 0.0005);
+        link.peripheral.set_capabilities(AUS1_CAPABILITY_FEC);
+        link.controller.set_fec_enabled(true);
+        CHECK(link.connect(1000));
+        CHECK(link.controller.get_capabilities() & AUS1_CAPABILITY_FEC);
+
+        size_t verified = 0;
+        std::vector<uint8_t> data;
+        for (int i = 0; i < 20; i++) {
+            if (!link.fetch(data, 1000)) continue;
+
+            verified++;
+            CHECK(data.size() == PAYLOAD_SIZE);
+            for (size_t j = 0; j < PAYLOAD_SIZE; j++) CHECK(data[j] == (uint8_t) (j * 31 + 7));
+        }
+
+        CHECK(verified >= 15);
+        CHECK(link.controller.get_corrected_bit_count() > 0);
+    }
+
+    return 0;
+}
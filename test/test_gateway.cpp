@@ -0,0 +1,210 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// End-to-end: a gateway worker fetches from a peripheral over the loopback bus and a separate mapping reads it back,
+// then two buses with several devices each, every device in its own slot.
+
+#include "test.h"
+
+#include "aus1_gateway.h"
+#include "arduino/aus1_peripheral.h"
+#include "i2c_loopback.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+using namespace superi2c;
+
+#define PERIPHERAL_TYPE    0x1234
+#define PERIPHERAL_VERSION 7
+#define PAYLOAD_SIZE       300 // several chunks
+
+static std::atomic<uint8_t> generation(0);
+
+// Every payload is filled with its generation, so a torn or stale copy is easy to spot
+static buf provide() {
+    uint8_t value = generation.fetch_add(1) + 1;
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = value;
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+// Filled with a tag, so a payload published into another device's slot is easy to spot
+template <uint8_t tag>
+static buf provide_tagged() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = tag;
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+/**
+ * @brief Waits until a slot has been published into at least `count` times
+ *
+ * @return Whether it was, within a few seconds
+ */
+static bool await_publishes(const aus1_gateway_region &reader, size_t index, uint64_t count) {
+    uint8_t data[PAYLOAD_SIZE];
+    uint64_t publish_count = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (publish_count < count && std::chrono::steady_clock::now() < deadline) {
+        reader.read(index, data, sizeof(data), &publish_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return publish_count >= count;
+}
+
+static bool filled_with(const aus1_gateway_region &reader, size_t index, uint8_t tag) {
+    uint8_t data[PAYLOAD_SIZE];
+    if (reader.read(index, data, sizeof(data)) != PAYLOAD_SIZE) return false;
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        if (data[i] != tag) return false;
+    }
+    return true;
+}
+
+int main() {
+    std::string name = "/aus1-gateway-test-" + std::to_string(getpid());
+
+    i2c_loopback_bus bus;
+    TwoWire controller_wire(&bus);
+    TwoWire peripheral_wire(&bus);
+    controller_wire.begin();
+    peripheral_wire.begin(AUS1_I2C_ADDRESS);
+
+    aus1_peripheral peripheral(&peripheral_wire, PERIPHERAL_TYPE, PERIPHERAL_VERSION, &provide);
+    peripheral.set_capabilities(AUS1_CAPABILITY_FEC);
+
+    aus1_gateway_region region;
+    CHECK(region.create(name.c_str(), 1));
+
+    // A second gateway cannot take over the region while it exists
+    aus1_gateway_region other;
+    CHECK(!other.create(name.c_str(), 1));
+
+    aus1_gateway gateway(&region);
+    CHECK(gateway.add_bus(&controller_wire));
+    CHECK(!gateway.add_bus(&controller_wire)); // no slot left
+    gateway.set_poll_interval(100);
+    CHECK(gateway.start());
+
+    // Readers map the region on their own, as another process would
+    aus1_gateway_region reader;
+    CHECK(reader.open(name.c_str()));
+    CHECK(reader.slot_count() == 1);
+
+    uint8_t data[PAYLOAD_SIZE];
+    uint64_t publish_count = 0;
+    size_t size = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (publish_count < 3 && std::chrono::steady_clock::now() < deadline) {
+        size = reader.read(0, data, sizeof(data), &publish_count);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    gateway.stop();
+
+    CHECK(publish_count >= 3);
+    CHECK(size == PAYLOAD_SIZE);
+    for (size_t i = 1; i < PAYLOAD_SIZE; i++) CHECK(data[i] == data[0]);
+    CHECK(data[0] != 0);
+
+    const aus1_gateway_slot *slot = reader.slot(0);
+    CHECK(slot->device_type == PERIPHERAL_TYPE);
+    CHECK(slot->device_version == PERIPHERAL_VERSION);
+
+    // Zero-copy reads see the same payload
+    size_t viewed = 0;
+    CHECK(reader.view(0, [&](const uint8_t *view_data, size_t view_size) {
+        viewed = view_size;
+        (void) view_data;
+    }));
+    CHECK(viewed == PAYLOAD_SIZE);
+
+    // Removing the region makes it unavailable to new readers, and frees the name
+    reader.close();
+    region.close();
+    CHECK(!reader.open(name.c_str()));
+    CHECK(other.create(name.c_str(), 1));
+    other.close();
+
+    // Two buses, with the same address on both, and a device on the second that never answers
+    {
+        i2c_loopback_bus bus_a, bus_b;
+        TwoWire controller_a(&bus_a), controller_b(&bus_b);
+        TwoWire wire_a0(&bus_a), wire_a1(&bus_a), wire_b0(&bus_b);
+        controller_a.begin();
+        controller_b.begin();
+        wire_a0.begin(0x20);
+        wire_a1.begin(0x21);
+        wire_b0.begin(0x20);
+        aus1_peripheral a0(&wire_a0, 0xA0, 1, &provide_tagged<0xA0>);
+        aus1_peripheral a1(&wire_a1, 0xA1, 1, &provide_tagged<0xA1>);
+        aus1_peripheral b0(&wire_b0, 0xB0, 1, &provide_tagged<0xB0>);
+
+        aus1_gateway_region devices;
+        CHECK(devices.create(name.c_str(), 4));
+        aus1_gateway two_buses(&devices);
+        const uint8_t addresses_a[] = { 0x20, 0x21 };
+        const uint8_t addresses_b[] = { 0x20, 0x30 };
+        CHECK(two_buses.add_bus(&controller_a, addresses_a, 2));
+        CHECK(two_buses.add_bus(&controller_b, addresses_b, 2));
+        CHECK(!two_buses.add_bus(&controller_b, addresses_b, 1)); // no slot left
+        two_buses.set_poll_interval(100);
+        CHECK(two_buses.start());
+
+        aus1_gateway_region reader_b;
+        CHECK(reader_b.open(name.c_str()));
+        CHECK(reader_b.slot_count() == 4);
+
+        // Devices sharing a bus take turns, so each keeps publishing, even past one that never connects
+        CHECK(await_publishes(reader_b, 0, 3));
+        CHECK(await_publishes(reader_b, 1, 3));
+        CHECK(await_publishes(reader_b, 2, 3));
+        two_buses.stop();
+
+        static const uint8_t buses[] = { 0, 0, 1, 1 };
+        static const uint8_t addresses[] = { 0x20, 0x21, 0x20, 0x30 };
+        static const uint8_t tags[] = { 0xA0, 0xA1, 0xB0 };
+        for (size_t i = 0; i < 4; i++) {
+            const aus1_gateway_slot *s = reader_b.slot(i);
+            CHECK(s->bus == buses[i] && s->address == addresses[i]);
+        }
+        for (size_t i = 0; i < 3; i++) {
+            CHECK(filled_with(reader_b, i, tags[i]));
+            CHECK(reader_b.slot(i)->device_type == tags[i]);
+        }
+
+        uint64_t absent_publishes = 1;
+        uint8_t data[PAYLOAD_SIZE];
+        CHECK(reader_b.read(3, data, sizeof(data), &absent_publishes) == 0 && absent_publishes == 0);
+    }
+
+    // A region left behind can be removed by name
+    {
+        aus1_gateway_region left_behind;
+        CHECK(left_behind.create(name.c_str(), 1));
+        CHECK(aus1_gateway_region::remove(name.c_str()));
+        CHECK(!aus1_gateway_region::remove(name.c_str()));
+    }
+
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Negotiable integrity checks: standard check values, running updates, START-OF-STREAM, and negotiation over a link.
+
+#include "test.h"
+#include "link.h"
+
+extern "C" {
+    #include "aus1.h"
+}
+
+#include <cstring>
+
+using namespace superi2c;
+
+#define PAYLOAD_SIZE 200
+
+static const uint8_t integrities[] = {
+    AUS1_INTEGRITY_CRC32, AUS1_INTEGRITY_CRC16_CCITT, AUS1_INTEGRITY_CRC8, AUS1_INTEGRITY_FLETCHER16
+};
+
+static uint32_t compute(uint8_t integrity, const char *text) {
+    return aus1_integrity_compute(integrity, (const uint8_t *) text, strlen(text));
+}
+
+static buf provide() {
+    uint8_t *data = new uint8_t[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) data[i] = (uint8_t) (i ^ 0x5A);
+    return buf{ data, PAYLOAD_SIZE };
+}
+
+int main() {
+    // Catalogued check values
+    CHECK(compute(AUS1_INTEGRITY_CRC32, "123456789") == 0xCBF43926);       // CRC-32/ISO-HDLC
+    CHECK(compute(AUS1_INTEGRITY_CRC16_CCITT, "123456789") == 0x29B1);     // CRC-16/IBM-3740 (CCITT-FALSE)
+    CHECK(compute(AUS1_INTEGRITY_CRC8, "123456789") == 0xF4);              // CRC-8/SMBUS
+    CHECK(compute(AUS1_INTEGRITY_FLETCHER16, "abcde") == 0xC8F0);
+    CHECK(compute(AUS1_INTEGRITY_FLETCHER16, "abcdef") == 0x2057);
+    CHECK(compute(AUS1_INTEGRITY_FLETCHER16, "abcdefgh") == 0x0627);
+
+    CHECK(aus1_integrity_size(AUS1_INTEGRITY_CRC32) == 4);
+    CHECK(aus1_integrity_size(AUS1_INTEGRITY_CRC16_CCITT) == 2);
+    CHECK(aus1_integrity_size(AUS1_INTEGRITY_CRC8) == 1);
+    CHECK(aus1_integrity_size(AUS1_INTEGRITY_FLETCHER16) == 2);
+    CHECK(aus1_integrity_size(0xEE) == 0); // unknown
+
+    // Fletcher-16 against a plain reference, over enough 0xFF bytes to overflow sums that are not reduced in time
+    {
+        uint8_t ones[1000];
+        memset(ones, 0xFF, sizeof(ones));
+        uint32_t sum1 = 0, sum2 = 0;
+        for (size_t i = 0; i < sizeof(ones); i++) {
+            sum1 = (sum1 + ones[i]) % 255;
+            sum2 = (sum2 + sum1) % 255;
+        }
+        CHECK(aus1_integrity_compute(AUS1_INTEGRITY_FLETCHER16, ones, sizeof(ones)) == ((sum2 << 8) | sum1));
+    }
+
+    uint8_t payload[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) payload[i] = (uint8_t) (i * 151 + 3);
+
+    for (uint8_t integrity : integrities) {
+        uint32_t expected = aus1_integrity_compute(integrity, payload, PAYLOAD_SIZE);
+
+        // Running updates split anywhere give the same value, as chunks are folded in one at a time
+        for (size_t split = 0; split <= PAYLOAD_SIZE; split += 7) {
+            uint32_t state = aus1_integrity_init(integrity);
+            state = aus1_integrity_update(integrity, state, payload, split);
+            state = aus1_integrity_update(integrity, state, payload + split, PAYLOAD_SIZE - split);
+            CHECK(aus1_integrity_final(integrity, state) == expected);
+        }
+
+        // A flipped bit changes the value
+        payload[17] ^= 0x04;
+        CHECK(aus1_integrity_compute(integrity, payload, PAYLOAD_SIZE) != expected);
+        payload[17] ^= 0x04;
+
+        // START-OF-STREAM carries only as many check bytes as the check needs
+        uint8_t packet[AUS1_START_OF_STREAM_PACKET_SIZE];
+        aus1_start_of_stream_packet start = { PAYLOAD_SIZE, expected, integrity };
+        aus1_encode_start_of_stream(packet, &start);
+        CHECK(aus1_start_of_stream_size(integrity) == 3 + aus1_integrity_size(integrity));
+
+        aus1_start_of_stream_packet decoded = aus1_decode_start_of_stream(packet, integrity);
+        CHECK(decoded.data_size == PAYLOAD_SIZE);
+        CHECK(decoded.check_value == expected);
+        CHECK(decoded.integrity == integrity);
+
+        // Anything but a START-OF-STREAM decodes as invalid
+        packet[0] ^= 0xFF;
+        CHECK(aus1_decode_start_of_stream(packet, integrity).data_size == 0);
+    }
+
+    // Each check is negotiated by PING, then carries a payload end to end
+    for (uint8_t integrity : integrities) {
+        aus1_link link(&provide);
+        link.controller.set_integrity(integrity);
+        CHECK(link.connect(1000));
+        CHECK(link.controller.get_integrity() == integrity);
+
+        std::vector<uint8_t> data;
+        CHECK(link.fetch(data, 1000));
+        CHECK(data.size() == PAYLOAD_SIZE);
+        for (size_t i = 0; i < PAYLOAD_SIZE; i++) CHECK(data[i] == (uint8_t) (i ^ 0x5A));
+    }
+
+    // A check the peripheral does not know falls back to CRC32
+    {
+        aus1_link link(&provide);
+        link.controller.set_integrity(0xEE);
+        CHECK(link.connect(1000));
+        CHECK(link.controller.get_integrity() == AUS1_INTEGRITY_CRC32);
+
+        std::vector<uint8_t> data;
+        CHECK(link.fetch(data, 1000));
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Tickless operation: the deadlines returned by update() and the events from wake_events(), for both ends, and the
+// duty cycle meters of a build with AUS1_MEASURE_DUTY_CYCLE. The application here sleeps exactly until each deadline.
+
+#include "test.h"
+#include "link.h"
+
+using namespace superi2c;
+
+#define PING_INTERVAL 100
+
+static buf provide() {
+    uint8_t *data = new uint8_t[64];
+    for (size_t i = 0; i < 64; i++) data[i] = (uint8_t) i;
+    return buf{ data, 64 };
+}
+
+static size_t count_pings(const std::vector<i2c_loopback_transfer> &trace) {
+    size_t pings = 0;
+    for (const i2c_loopback_transfer &transfer : trace) {
+        if (!transfer.read && transfer.length == AUS1_PING_PACKET_SIZE) pings++;
+    }
+    return pings;
+}
+
+int main() {
+    // Nested active periods count once, from the outermost begin to the outermost end
+    {
+        duty_cycle_meter meter;
+        duty_cycle_reset(&meter, 0);
+        duty_cycle_begin(&meter, 10);
+        duty_cycle_begin(&meter, 20);
+        duty_cycle_end(&meter, 30);
+        duty_cycle_end(&meter, 40);
+        duty_cycle_end(&meter, 50); // unmatched
+        CHECK(meter.active_us == 30 && meter.calls == 1);
+        CHECK(duty_cycle_permille(&meter, 100) == 300);
+    }
+
+    aus1_link link(&provide);
+    link.peripheral_wire.enableGeneralCall(true);
+    CHECK(link.connect(1000));
+
+    // Idle, the controller only needs waking for its next PING, and the peripheral only by the bus
+    link.controller.set_ping_interval(PING_INTERVAL);
+    CHECK(link.controller.wake_events() == AUS1_WAKE_DEADLINE);
+    CHECK(link.peripheral.wake_events() == AUS1_WAKE_BUS);
+    CHECK(link.peripheral.update() == AUS1_NO_DEADLINE);
+
+    // Sleeping until each deadline PINGs once per interval, with no updates in between
+    {
+        link.controller.reset_duty_cycle();
+        link.peripheral.reset_duty_cycle();
+        link.bus.clear_trace();
+        link.bus.set_trace(true);
+
+        unsigned long start = millis(), updates = 0, longest = 0;
+        while (millis() - start < 1000) {
+            unsigned long delay = link.controller.update();
+            updates++;
+            CHECK(delay != AUS1_NO_DEADLINE && delay <= PING_INTERVAL + 1);
+            if (delay > longest) longest = delay;
+            host_clock_advance((delay == 0 ? 1 : delay) * 1000);
+        }
+        link.bus.set_trace(false);
+
+        size_t pings = count_pings(link.bus.get_trace());
+        CHECK(link.controller.connected());
+        CHECK(longest == PING_INTERVAL + 1);
+        CHECK(pings >= 1000 / (PING_INTERVAL + 2) && pings <= 1000 / PING_INTERVAL + 1);
+        CHECK(updates <= 2 * pings + 2);
+
+        // The meters count every update, and each PING's write and read as two peripheral callbacks
+        CHECK(link.controller.get_duty_cycle().calls == updates);
+        CHECK(link.peripheral.get_duty_cycle().calls == 2 * pings);
+
+        // Transfers take their bus time inside update(), so the controller is active for a PING per interval
+        uint16_t permille = duty_cycle_permille(&link.controller.get_duty_cycle(), micros());
+        CHECK(permille > 0 && permille < 50);
+    }
+
+    // A shorter interval PINGs more often
+    {
+        link.controller.set_ping_interval(10);
+        link.bus.clear_trace();
+        link.bus.set_trace(true);
+        unsigned long start = millis();
+        while (millis() - start < 1000) {
+            unsigned long delay = link.controller.update();
+            CHECK(delay <= 10 + 1);
+            host_clock_advance((delay == 0 ? 1 : delay) * 1000);
+        }
+        link.bus.set_trace(false);
+        // Each cycle also takes the PING's bus time and the update reading its response
+        CHECK(count_pings(link.bus.get_trace()) >= 1000 / (10 + 4));
+        link.controller.set_ping_interval(PING_INTERVAL);
+    }
+
+    // A request is started on the next update, and then the peripheral's reply can arrive before the deadline
+    {
+        link.controller.request_data([](uint8_t *, size_t, size_t) {});
+        CHECK(link.controller.update() == 0);
+        CHECK(link.controller.get_state() != aus1_controller_state::IDLE);
+        CHECK(link.controller.wake_events() == (AUS1_WAKE_DEADLINE | AUS1_WAKE_BUS));
+        link.controller.cancel_request();
+    }
+
+    // Discovery wakes the peripheral for its reply slot, and the controller for the end of the round
+    {
+        link.controller.discover();
+        while (link.controller.get_state() != aus1_controller_state::DISCOVERING) link.step();
+
+        unsigned long delay = link.controller.update();
+        CHECK(delay > 0 && delay <= ((unsigned long) AUS1_DEFAULT_DISCOVERY_WINDOW_MS << AUS1_DISCOVERY_ATTEMPTS) + 1);
+        CHECK(link.controller.wake_events() == (AUS1_WAKE_DEADLINE | AUS1_WAKE_BUS));
+
+        CHECK(link.peripheral.wake_events() == (AUS1_WAKE_DEADLINE | AUS1_WAKE_BUS));
+        delay = link.peripheral.update();
+        CHECK(delay < AUS1_DEFAULT_DISCOVERY_WINDOW_MS);
+
+        // Once it has answered, the peripheral is back to waiting on the bus
+        host_clock_advance(delay * 1000);
+        link.peripheral.update();
+        CHECK(link.peripheral.update() == AUS1_NO_DEADLINE);
+        CHECK(link.peripheral.wake_events() == AUS1_WAKE_BUS);
+
+        link.controller.update();
+        CHECK(link.controller.get_peripheral_count() == 1);
+    }
+
+    return 0;
+}
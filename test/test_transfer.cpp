@@ -0,0 +1,145 @@
+/**
+ * Copyright 2025 John Jerney
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+
+// Controller to peripheral transfers over the loopback bus: payload sizes around chunk boundaries, the shape of
+// a stream on the bus, and starting afresh after a stream is abandoned.
+
+#include "test.h"
+#include "link.h"
+
+using namespace superi2c;
+
+static size_t payload_size;
+static uint8_t generation;
+
+// Each payload is tagged with its generation, so a stale stream is told apart from a fresh one
+static buf provide() {
+    generation++;
+    uint8_t *data = new uint8_t[payload_size];
+    for (size_t i = 0; i < payload_size; i++) data[i] = (uint8_t) (i * 7 + generation);
+    return buf{ data, payload_size };
+}
+
+static bool matches(const std::vector<uint8_t> &data, uint8_t tag) {
+    if (data.size() != payload_size) return false;
+    for (size_t i = 0; i < data.size(); i++) {
+        if (data[i] != (uint8_t) (i * 7 + tag)) return false;
+    }
+    return true;
+}
+
+int main() {
+    static const size_t sizes[] = { 1, 27, 28, 29, 31, 32, 33, 500, 4096 };
+
+    for (int fec = 0; fec < 2; fec++) {
+        for (size_t size : sizes) {
+            payload_size = size;
+
+            aus1_link link(&provide);
+            link.peripheral.set_capabilities(AUS1_CAPABILITY_FEC);
+            link.controller.set_fec_enabled(fec);
+            CHECK(link.connect(1000));
+
+            link.bus.set_trace(true);
+            std::vector<uint8_t> data;
+            CHECK(link.fetch(data, 5000));
+            CHECK(matches(data, generation));
+
+            // STREAM-REQUEST, START-OF-STREAM, then one read per chunk and nothing else
+            size_t chunk_data_size = fec ? AUS1_FEC_CHUNK_DATA_SIZE : AUS1_DATA_PACKET_SIZE;
+            size_t chunk_count = (size + chunk_data_size - 1) / chunk_data_size;
+            std::vector<i2c_loopback_transfer> trace = link.bus.get_trace();
+            CHECK(trace.size() == 2 + chunk_count);
+            CHECK(!trace[0].read && trace[0].length == AUS1_STREAM_REQUEST_PACKET_SIZE);
+            CHECK(trace[1].read && trace[1].length == aus1_start_of_stream_size(AUS1_INTEGRITY_CRC32));
+            for (size_t i = 2; i < trace.size(); i++) CHECK(trace[i].read && trace[i].length == AUS1_DATA_PACKET_SIZE);
+
+            // Fetches follow each other without waiting on the idle drain window
+            unsigned long start = millis();
+            for (int i = 0; i < 5; i++) {
+                CHECK(link.fetch(data, 5000));
+                CHECK(matches(data, generation));
+            }
+            unsigned long bus_ms = 5 * trace.size() * link.bus.transfer_ns(AUS1_DATA_PACKET_SIZE) / 1000000 + 1;
+            CHECK(millis() - start <= bus_ms + 5);
+        }
+    }
+
+    // A stream abandoned halfway is dropped by the peripheral, and the next one starts from its beginning
+    {
+        payload_size = 500;
+        aus1_link link(&provide);
+        CHECK(link.connect(1000));
+
+        link.controller.request_data([](uint8_t *, size_t, size_t) { CHECK(false); });
+        while (link.controller.get_state() != aus1_controller_state::RECEIVING_DATA) link.step();
+        for (int i = 0; i < 4; i++) link.step();
+        uint8_t abandoned = generation;
+        link.controller.cancel_request();
+
+        std::vector<uint8_t> data;
+        CHECK(link.fetch(data, 1000));
+        CHECK(generation != abandoned);
+        CHECK(matches(data, generation));
+
+        // PING is still answered, rather than mistaken for a read of the old stream
+        for (int i = 0; i < 100; i++) link.step();
+        CHECK(link.controller.connected());
+        CHECK(link.fetch(data, 1000));
+        CHECK(matches(data, generation));
+    }
+
+    // A peripheral unplugged between fetches fails the next one at once, and is then only looked for at each PING
+    {
+        payload_size = 64;
+        aus1_link link(&provide);
+        CHECK(link.connect(1000));
+        link.peripheral_wire.end();
+
+        std::vector<uint8_t> data;
+        unsigned long start = millis();
+        CHECK(!link.fetch(data, 1000));
+        CHECK(millis() - start <= 1);
+        CHECK(!link.controller.connected());
+        CHECK(link.controller.get_state() == aus1_controller_state::IDLE);
+
+        // Keep asking, as the gateway would once connected again; nothing but PINGs reaches the bus meanwhile
+        link.bus.set_trace(true);
+        start = millis();
+        unsigned long busy_updates = 0;
+        while (millis() - start < 200) {
+            if (!link.controller.has_receiver()) link.controller.request_data([](uint8_t *, size_t, size_t) {});
+            if (link.controller.update() == 0) busy_updates++;
+            link.peripheral.update();
+            host_clock_advance(1000);
+        }
+        CHECK(link.bus.get_trace().size() <= 200 / 20 + 1);
+        CHECK(busy_updates <= 200 / 20 + 1);
+        link.controller.cancel_request();
+    }
+
+    // Without a peripheral, reads are not acknowledged and the controller never connects
+    {
+        payload_size = 10;
+        aus1_link link(&provide);
+        link.controller.set_peripheral_address(0x21);
+        CHECK(!link.connect(200));
+    }
+
+    return 0;
+}